@@ -0,0 +1,563 @@
+/*
+ * Comb detection and weaving shared by the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * Based on vf_fieldmatch:
+ * Copyright (c) 2012 Fredrik Mellbin
+ * Copyright (c) 2013 Clément Bœsch
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "avfilter.h"
+#include "filters.h"
+#include "fmdif_comb.h"
+#include "video.h"
+
+static int get_width(const FMDIFCombContext *s, int width, int plane)
+{
+    return plane ? AV_CEIL_RSHIFT(width, s->hsub) : width;
+}
+
+static int get_height(const FMDIFCombContext *s, int height, int plane)
+{
+    return plane ? AV_CEIL_RSHIFT(height, s->vsub) : height;
+}
+
+static void copy_fields(const FMDIFCombContext *s, AVFrame *dst,
+                        const AVFrame *src, int field)
+{
+    int plane;
+    for (plane = 0; plane < 4 && src->data[plane] && src->linesize[plane]; plane++) {
+        const int plane_h = get_height(s, src->height, plane);
+        const int nb_copy_fields = (plane_h >> 1) + (field ? 0 : (plane_h & 1));
+        av_image_copy_plane(dst->data[plane] + field*dst->linesize[plane], dst->linesize[plane] << 1,
+                            src->data[plane] + field*src->linesize[plane], src->linesize[plane] << 1,
+                            (get_width(s, src->width, plane) * s->bpc) << (plane && s->interleaved), nb_copy_fields);
+    }
+}
+
+/* The weaves are references to buffers allocated once, a buffer being free
+ * again as soon as the reference handed out is. A fresh buffer is only taken
+ * from the link if all are still in use. The buffers only grow, as the comb
+ * masks, and are cropped to the frame size. */
+static void free_weave_pool(FMDIFCombContext *s)
+{
+    int i;
+
+    for (i = 0; i < FMDIF_WEAVE_POOL_SIZE; i++)
+        av_frame_free(&s->weave_pool[i]);
+}
+
+static AVFrame *get_weave_buffer(FMDIFCombContext *s, AVFilterLink *link)
+{
+    int i;
+
+    for (i = 0; i < FMDIF_WEAVE_POOL_SIZE; i++) {
+        if (s->weave_pool[i] && av_frame_is_writable(s->weave_pool[i])) {
+            AVFrame *frame = av_frame_clone(s->weave_pool[i]);
+
+            if (frame) {
+                frame->width  = link->w;
+                frame->height = link->h;
+            }
+            return frame;
+        }
+    }
+    return ff_get_video_buffer(link, link->w, link->h);
+}
+
+AVFrame *ff_fmdif_comb_weave(FMDIFCombContext *s, AVFilterLink *link, int match, int field,
+                             const AVFrame *prv, AVFrame *src, const AVFrame *nxt)
+{
+    AVFrame *dst;
+
+    if (match == mC) {
+        dst = av_frame_clone(src);
+    } else {
+        dst = get_weave_buffer(s, link);
+        if (!dst)
+            return NULL;
+        av_frame_copy_props(dst, src);
+
+        switch (match) {
+        case mP: copy_fields(s, dst, src, 1-field); copy_fields(s, dst, prv, field); break;
+        case mN: copy_fields(s, dst, src, field); copy_fields(s, dst, nxt, 1-field); break;
+        default: av_assert0(0);
+        }
+    }
+    return dst;
+}
+
+static void fill_buf(uint8_t *data, int w, int h, int linesize, uint8_t v)
+{
+    int y;
+
+    for (y = 0; y < h; y++) {
+        memset(data, v, w);
+        data += linesize;
+    }
+}
+
+/*
+ * Coarse-to-fine luma comb score. Combing being vertical, the mask is first
+ * built on the even columns only, and each block count doubled. Unless the
+ * highest estimate is clearly away from combpel, the blocks estimated at less
+ * than combtol below it are refined: their odd columns are masked and they are
+ * counted at full resolution, so the decision only differs from the full
+ * resolution one for an estimate off by more than combtol.
+ */
+static int calc_combed_score_coarse(const FMDIFCombContext *s, const FMDIFCombView *src, int job)
+{
+    /* high byte of the semi-planar samples, as in comb_mask_plane() */
+    const int step = s->interleaved ? s->bpc : 1;
+    const uint8_t *srcp = src->data[0] + step - 1;
+    const int src_linesize = src->linesize[0];
+    uint8_t *cmask = s->cmask_data[job][0];
+    const int cmk_linesize = s->cmask_linesize[job][0];
+    const int width  = src->width;
+    const int height = src->height;
+    const int blockx = s->blockx;
+    const int blocky = s->blocky;
+    const int xhalf = blockx/2;
+    const int yhalf = blocky/2;
+    const int xblocks = ((width+xhalf)/blockx) + 1;
+    const int xblocks4 = xblocks<<2;
+    const int yblocks = ((height+yhalf)/blocky) + 1;
+    const int arraysize = (xblocks*yblocks)<<2;
+    const int lo = s->combpel - s->combtol;
+    const int hi = s->combpel + s->combtol;
+    int *c_array = s->c_array[job];
+    int i, x, y, max_v = 0;
+
+    fill_buf(cmask, width, height, cmk_linesize, 0);
+    for (y = 0; y < height; y++)
+        ff_fmdif_comb_mask_line(cmask + y * cmk_linesize, srcp, src_linesize, step, y, height,
+                                0, width, 2, s->cthresh);
+
+    memset(c_array, 0, arraysize * sizeof(*c_array));
+    for (y = 1; y < height - 1; y++) {
+        const uint8_t *cmkp = cmask + y * cmk_linesize;
+        const int temp1 = (y / blocky) * xblocks4;
+        const int temp2 = ((y + yhalf) / blocky) * xblocks4;
+        for (x = 0; x < width; x += 2) {
+            if (cmkp[x - cmk_linesize] == 0xff &&
+                cmkp[x               ] == 0xff &&
+                cmkp[x + cmk_linesize] == 0xff) {
+                const int box1 = (x / blockx) * 4;
+                const int box2 = ((x + xhalf) / blockx) * 4;
+                c_array[temp1 + box1    ] += 2;
+                c_array[temp1 + box2 + 1] += 2;
+                c_array[temp2 + box1 + 2] += 2;
+                c_array[temp2 + box2 + 3] += 2;
+            }
+        }
+    }
+    for (i = 0; i < arraysize; i++)
+        max_v = FFMAX(max_v, c_array[i]);
+    if (max_v < lo || max_v > hi)
+        return max_v;
+
+    max_v = 0;
+    for (i = 0; i < arraysize; i++) {
+        /* entry i is the block (bx, by) of one of the four grids offset by half a block */
+        const int bx = (i >> 2) % xblocks;
+        const int by = (i >> 2) / xblocks;
+        const int x0 = FFMAX(bx * blockx - (i & 1 ? xhalf : 0), 0);
+        const int y0 = FFMAX(by * blocky - (i & 2 ? yhalf : 0), 1);
+        const int x1 = FFMIN(bx * blockx - (i & 1 ? xhalf : 0) + blockx, width);
+        const int y1 = FFMIN(by * blocky - (i & 2 ? yhalf : 0) + blocky, height - 1);
+
+        if (c_array[i] >= lo && x0 < x1 && y0 < y1) {
+            const int mx0 = x0 | 1;
+
+            c_array[i] = 0;
+            for (y = y0 - 1; y <= y1; y++)
+                ff_fmdif_comb_mask_line(cmask + y * cmk_linesize, srcp, src_linesize, step, y, height,
+                                        mx0, x1, 2, s->cthresh);
+            for (y = y0; y < y1; y++) {
+                const uint8_t *cmkp = cmask + y * cmk_linesize;
+                for (x = x0; x < x1; x++)
+                    if (cmkp[x - cmk_linesize] == 0xff &&
+                        cmkp[x               ] == 0xff &&
+                        cmkp[x + cmk_linesize] == 0xff)
+                        c_array[i]++;
+            }
+        }
+        max_v = FFMAX(max_v, c_array[i]);
+    }
+    return max_v;
+}
+
+/*
+ * Field difference metric: the sum of absolute differences between each line
+ * and the next, i.e. between the lines of one field and those of the other.
+ * It only takes two SAD passes over the luma, against the five-line filter,
+ * mask and block windows of the comb score.
+ */
+static int calc_field_diff_score(const FMDIFCombContext *s, const FMDIFCombView *src)
+{
+    const uint8_t *srcp = src->data[0];
+    const ptrdiff_t linesize = src->linesize[0];
+    const int height = src->height;
+    uint64_t sad0 = 0, sad1 = 0;
+
+    /* even lines with the ones below, then odd lines with the ones below */
+    s->sad(srcp, 2 * linesize, srcp + linesize, 2 * linesize,
+           src->width, height / 2, &sad0);
+    s->sad(srcp + linesize, 2 * linesize, srcp + 2 * linesize, 2 * linesize,
+           src->width, (height - 1) / 2, &sad1);
+    return (sad0 + sad1) * FMDIF_FIELDDIFF_SCALE /
+           ((uint64_t)src->width * (height - 1) << (s->depth - 8));
+}
+
+int ff_fmdif_comb_thresh(const FMDIFCombContext *s)
+{
+    if (s->metric == FMDIF_METRIC_FIELDDIFF)
+        return lrint(s->fdthresh * FMDIF_FIELDDIFF_SCALE);
+    return s->combpel;
+}
+
+static void comb_mask_plane(const FMDIFCombContext *s, const FMDIFCombView *src, int job, int plane)
+{
+    /* semi-planar formats are scored on the high byte of their samples, which
+     * are MSB aligned, with U and V apart */
+    const int interleaved = plane && s->interleaved;
+    const int hi = s->interleaved ? s->bpc - 1 : 0;
+    const int step = s->interleaved ? s->bpc << interleaved : 1;
+    const uint8_t *srcp = interleaved ? src->data[1] + (plane - 1) * s->bpc + hi
+                                      : src->data[plane] + hi;
+
+    ff_fmdif_comb_mask_plane(s->cmask_data[job][plane], s->cmask_linesize[job][plane],
+                             srcp, src->linesize[interleaved ? 1 : plane],
+                             get_width (s, src->width,  plane),
+                             get_height(s, src->height, plane), step, s->cthresh);
+}
+
+/* mark as combed the luma around the chroma combed in both directions */
+static void comb_mask_dilate_chroma(const FMDIFCombContext *s, const FMDIFCombView *src, int job)
+{
+    ff_fmdif_comb_dilate_chroma(s->cmask_data[job][0], s->cmask_linesize[job][0],
+                                s->cmask_data[job][1], s->cmask_data[job][2], s->cmask_linesize[job][2],
+                                AV_CEIL_RSHIFT(src->width,  s->hsub),
+                                AV_CEIL_RSHIFT(src->height, s->vsub));
+}
+
+static int count_blocks(const FMDIFCombContext *s, const FMDIFCombView *src, int job)
+{
+    return s->count_blocks(s->cmask_data[job][0], s->cmask_linesize[job][0],
+                           src->width, src->height, s->blockx, s->blocky, s->c_array[job]);
+}
+
+/* luma mask and block count in one pass, see comb_mask_plane() for the samples */
+static int score_luma(const FMDIFCombContext *s, const FMDIFCombView *src, int job)
+{
+    const int hi = s->interleaved ? s->bpc - 1 : 0;
+
+    return s->score_luma(s->cmask_data[job][0], s->cmask_linesize[job][0],
+                         src->data[0] + hi, src->linesize[0], src->width, src->height,
+                         s->blockx, s->blocky, s->cthresh, s->c_array[job]);
+}
+
+static int score_view(const FMDIFCombContext *s, const FMDIFCombView *src, int job, int full)
+{
+    if (s->metric == FMDIF_METRIC_FIELDDIFF)
+        return calc_field_diff_score(s, src);
+    if (s->combtol > 0 && !s->chroma && s->cthresh >= 0)
+        return calc_combed_score_coarse(s, src, job);
+
+    /* with a negative cthresh, the luma is combed everywhere already */
+    if (!s->chroma || s->cthresh < 0)
+        return score_luma(s, src, job);
+
+    /* the chroma only adds combed pixels, so the luma score is a lower bound */
+    if (!full && s->chromatol > 0)
+        return score_luma(s, src, job);
+
+    comb_mask_plane(s, src, job, 0);
+    comb_mask_plane(s, src, job, 1);
+    comb_mask_plane(s, src, job, 2);
+    comb_mask_dilate_chroma(s, src, job);
+    return count_blocks(s, src, job);
+}
+
+int ff_fmdif_comb_chromatol(const FMDIFCombContext *s)
+{
+    if (s->metric == FMDIF_METRIC_FIELDDIFF || !s->chroma || s->cthresh < 0)
+        return 0;
+    return s->chromatol;
+}
+
+int ff_fmdif_comb_score(const FMDIFCombContext *s, const AVFrame *src, int job, int full)
+{
+    const int x = s->win_x, y = s->win_y;
+    FMDIFCombView view = { .width = s->win_w, .height = s->win_h };
+    int plane;
+
+    for (plane = 0; plane < 3 && src->data[plane]; plane++) {
+        const int interleaved = plane && s->interleaved;
+        const int px = plane ? x >> s->hsub : x;
+        const int py = plane ? y >> s->vsub : y;
+
+        view.data[plane]     = src->data[plane] + py * src->linesize[plane] +
+                               px * (s->bpc << interleaved);
+        view.linesize[plane] = src->linesize[plane];
+    }
+    return score_view(s, &view, job, full);
+}
+
+typedef struct CombJobData {
+    const FMDIFCombContext *s;
+    const AVFrame *frames[FMDIF_COMB_MAX_JOBS];
+    int full;
+    int scores[FMDIF_COMB_MAX_JOBS];
+} CombJobData;
+
+static int score_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    CombJobData *cd = arg;
+
+    cd->scores[jobnr] = ff_fmdif_comb_score(cd->s, cd->frames[jobnr], jobnr, cd->full);
+    return 0;
+}
+
+void ff_fmdif_comb_score2(AVFilterContext *ctx, const FMDIFCombContext *s,
+                          const AVFrame *a, const AVFrame *b, int full, int *score_a, int *score_b)
+{
+    CombJobData cd = { .s = s, .frames = { a, b }, .full = full };
+
+    ff_filter_execute(ctx, score_job, &cd, NULL, FMDIF_COMB_MAX_JOBS);
+    *score_a = cd.scores[0];
+    *score_b = cd.scores[1];
+}
+
+/* The buffers only grow, so switching back to a previous size or to larger
+ * blocks does not reallocate them. The comb mask is planar 8-bit whatever the
+ * input format, as only the mask values are stored. */
+static int alloc_cmask(FMDIFCombContext *s, int w, int h)
+{
+    const int nb_jobs = s->nb_jobs;
+    int i, ret;
+
+    if (s->cmask_data[0][0] && w <= s->cmask_w && h <= s->cmask_h)
+        return 0;
+    w = FFMAX(w, s->cmask_w);
+    h = FFMAX(h, s->cmask_h);
+    for (i = 0; i < nb_jobs; i++) {
+        av_freep(&s->cmask_data[i][0]);
+        if ((ret = av_image_alloc(s->cmask_data[i], s->cmask_linesize[i], w, h, AV_PIX_FMT_YUV444P, 32)) < 0)
+            return ret;
+    }
+    s->cmask_w = w;
+    s->cmask_h = h;
+    return 0;
+}
+
+int ff_fmdif_comb_alloc_blocks(FMDIFCombContext *s, int w, int h)
+{
+    const int size = ff_fmdif_comb_blocks_size(w, h, s->blockx, s->blocky);
+    const int nb_jobs = s->nb_jobs;
+    int i;
+
+    if (size > s->c_array_size) {
+        for (i = 0; i < nb_jobs; i++) {
+            int *c_array = av_malloc_array(size, sizeof(*c_array));
+            if (!c_array)
+                return AVERROR(ENOMEM);
+            av_freep(&s->c_array[i]);
+            s->c_array[i] = c_array;
+        }
+        s->c_array_size = size;
+    }
+
+    /* only once the counters fit, as the caller keeps the old sizes on failure */
+    s->count_blocks = ff_fmdif_comb_count_blocks_fn(s->blockx, s->blocky);
+    s->score_luma   = ff_fmdif_comb_score_luma_fn(s->blockx, s->blocky,
+                                                  s->interleaved ? s->bpc : 1, s->cthresh);
+    return 0;
+}
+
+static int alloc_weave_pool(FMDIFCombContext *s, const AVFilterLink *link)
+{
+    const AVFrame *pool = s->weave_pool[FMDIF_WEAVE_POOL_SIZE - 1];
+    int i, ret, w = link->w, h = link->h;
+
+    if (pool && pool->format == link->format) {
+        if (w <= pool->width && h <= pool->height)
+            return 0;
+        w = FFMAX(w, pool->width);
+        h = FFMAX(h, pool->height);
+    }
+    free_weave_pool(s);
+    for (i = 0; i < FMDIF_WEAVE_POOL_SIZE; i++) {
+        AVFrame *frame = av_frame_alloc();
+
+        if (!frame)
+            return AVERROR(ENOMEM);
+        s->weave_pool[i] = frame;
+        frame->width  = w;
+        frame->height = h;
+        frame->format = link->format;
+        if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+/* smallest analysis window, so that the filters always have a few lines to work on */
+#define MIN_WINDOW_SIZE 32
+
+/*
+ * Set the window to the rectangle (x0, y0)-(x1, y1) of a w x h frame, grown to
+ * keep whole chroma samples and the field parity of the luma and chroma
+ * lines. Return 0 and leave it unchanged if it is too small.
+ */
+static int set_window(FMDIFCombContext *s, int w, int h, int x0, int y0, int x1, int y1)
+{
+    const int xalign = 1 << s->hsub;
+    const int yalign = 2 << s->vsub;
+
+    x0 &= ~(xalign - 1);
+    y0 &= ~(yalign - 1);
+    x1 = FFMIN(FFALIGN(x1, xalign), w);
+    y1 = FFMIN(FFALIGN(y1, yalign), h);
+    if (x1 - x0 < FFMIN(MIN_WINDOW_SIZE, w) || y1 - y0 < FFMIN(MIN_WINDOW_SIZE, h))
+        return 0;
+    s->win_x = x0;
+    s->win_y = y0;
+    s->win_w = x1 - x0;
+    s->win_h = y1 - y0;
+    return 1;
+}
+
+/* whether the mean of n luma samples step bytes apart is at most borderthresh */
+static int is_black_line(const FMDIFCombContext *s, const uint8_t *p, ptrdiff_t step, int n)
+{
+    const int64_t thresh = ((int64_t)s->borderthresh << (s->depth - 8)) * n;
+    int64_t sum = 0;
+    int i;
+
+    if (s->bpc == 1) {
+        for (i = 0; i < n; i++)
+            sum += p[i * step];
+    } else {
+        for (i = 0; i < n; i++)
+            sum += AV_RN16(p + i * step);
+    }
+    return sum <= thresh;
+}
+
+int ff_fmdif_comb_detect_borders(FMDIFCombContext *s, const AVFrame *frame)
+{
+    const uint8_t *data = frame->data[0];
+    const ptrdiff_t linesize = frame->linesize[0];
+    const int bpc = s->bpc;
+    int x0 = s->roi_wx, x1 = s->roi_wx + s->roi_ww;
+    int y0 = s->roi_wy, y1 = s->roi_wy + s->roi_wh;
+    const int detect = !s->border_count;
+    const int win_x = s->win_x, win_y = s->win_y, win_w = s->win_w, win_h = s->win_h;
+
+    if (!s->borders)
+        return 0;
+    s->border_count = (s->border_count + 1) % s->borders;
+    if (!detect)
+        return 0;
+
+    while (y0 < y1 && is_black_line(s, data + y0 * linesize + x0 * bpc, bpc, x1 - x0))
+        y0++;
+    while (y1 > y0 && is_black_line(s, data + (y1 - 1) * linesize + x0 * bpc, bpc, x1 - x0))
+        y1--;
+    /* columns are only sampled on every fourth line */
+    while (x0 < x1 && is_black_line(s, data + y0 * linesize + x0 * bpc, 4 * linesize, (y1 - y0 + 3) / 4))
+        x0++;
+    while (x1 > x0 && is_black_line(s, data + y0 * linesize + (x1 - 1) * bpc, 4 * linesize, (y1 - y0 + 3) / 4))
+        x1--;
+
+    /* a black or nearly black frame keeps the previous window */
+    set_window(s, frame->width, frame->height, x0, y0, x1, y1);
+    return s->win_x != win_x || s->win_y != win_y || s->win_w != win_w || s->win_h != win_h;
+}
+
+int ff_fmdif_comb_set_borders(FMDIFCombContext *s, int count, int x, int y, int w, int h)
+{
+    const int x1 = s->roi_wx + s->roi_ww;
+    const int y1 = s->roi_wy + s->roi_wh;
+
+    if (count < 0 || count >= FFMAX(s->borders, 1) || w <= 0 || h <= 0 ||
+        x < s->roi_wx || x > x1 - w || y < s->roi_wy || y > y1 - h ||
+        !set_window(s, x1, y1, x, y, x + w, y + h))
+        return 0;
+    s->border_count = count;
+    return 1;
+}
+
+int ff_fmdif_comb_config(FMDIFCombContext *s, const AVFilterLink *link)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
+    const int x0 = av_clip(s->roi_x, 0, link->w);
+    const int y0 = av_clip(s->roi_y, 0, link->h);
+    const int x1 = s->roi_w ? FFMIN(x0 + s->roi_w, link->w) : link->w;
+    const int y1 = s->roi_h ? FFMIN(y0 + s->roi_h, link->h) : link->h;
+    int ret;
+
+    s->nb_jobs     = av_clip(s->nb_jobs, 1, FMDIF_COMB_MAX_JOBS);
+    s->hsub        = desc->log2_chroma_w;
+    s->vsub        = desc->log2_chroma_h;
+    s->bpc         = (desc->comp[0].depth + 7) / 8;
+    s->interleaved = desc->nb_components > 2 && desc->comp[1].plane == desc->comp[2].plane;
+    s->depth       = desc->comp[0].depth + desc->comp[0].shift;
+    s->sad         = ff_scene_sad_get_fn(s->depth > 8 ? 16 : 8);
+    if (!s->sad)
+        return AVERROR(EINVAL);
+
+    if (!set_window(s, link->w, link->h, x0, y0, x1, y1)) {
+        av_log(link->dst, AV_LOG_WARNING, "Analysis rectangle too small for %dx%d, using the whole frame\n",
+               link->w, link->h);
+        set_window(s, link->w, link->h, 0, 0, link->w, link->h);
+    }
+    s->roi_wx = s->win_x;
+    s->roi_wy = s->win_y;
+    s->roi_ww = s->win_w;
+    s->roi_wh = s->win_h;
+    s->border_count = 0;
+
+    if ((ret = alloc_cmask(s, link->w, link->h)) < 0 ||
+        (ret = alloc_weave_pool(s, link)) < 0)
+        return ret;
+    return ff_fmdif_comb_alloc_blocks(s, link->w, link->h);
+}
+
+void ff_fmdif_comb_uninit(FMDIFCombContext *s)
+{
+    int i;
+
+    for (i = 0; i < FMDIF_COMB_MAX_JOBS; i++) {
+        av_freep(&s->cmask_data[i][0]);
+        av_freep(&s->c_array[i]);
+    }
+    s->cmask_w = s->cmask_h = s->c_array_size = 0;
+    free_weave_pool(s);
+}
@@ -0,0 +1,161 @@
+/*
+ * Comb detection and weaving shared by the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * Based on vf_fieldmatch:
+ * Copyright (c) 2012 Fredrik Mellbin
+ * Copyright (c) 2013 Clément Bœsch
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FMDIF_COMB_H
+#define AVFILTER_FMDIF_COMB_H
+
+#include <stdint.h>
+
+#include "libavutil/frame.h"
+#include "avfilter.h"
+#include "fmdif_core.h"
+#include "scene_sad.h"
+
+/* scratch buffers of the comb scoring, one per candidate scored at once */
+#define FMDIF_COMB_MAX_JOBS 2
+
+/* at most two weaves are alive at once */
+#define FMDIF_WEAVE_POOL_SIZE 2
+
+enum FMDIFMetric {
+    FMDIF_METRIC_COMB,              ///< fieldmatch comb score
+    FMDIF_METRIC_FIELDDIFF,         ///< mean difference of adjacent lines
+};
+
+/* fielddiff scores are in 1/FMDIF_FIELDDIFF_SCALE of an 8-bit level */
+#define FMDIF_FIELDDIFF_SCALE 16
+
+/* the part of a frame that is analyzed, see ff_fmdif_comb_score() */
+typedef struct FMDIFCombView {
+    const uint8_t *data[3];
+    int linesize[3];
+    int width, height;
+} FMDIFCombView;
+
+typedef struct FMDIFCombContext {
+    /* options, set by the filter */
+    int cthresh;
+    int chroma;
+    int blockx, blocky;
+    int combpel;
+    int combtol;
+    int chromatol;
+    int metric;                     ///< FMDIFMetric
+    double fdthresh;                ///< fielddiff threshold, in 8-bit levels
+    int nb_jobs;                    ///< number of candidates scored at once
+    int roi_x, roi_y, roi_w, roi_h; ///< analysis rectangle, 0 size for the whole frame
+    int borders;                    ///< frames between black border detections, 0 to disable
+    int borderthresh;               ///< mean luma of a black border line, in 8-bit scale
+
+    /* properties of the input, set by ff_fmdif_comb_config() */
+    int hsub, vsub;                 ///< chroma subsampling values
+    int bpc;                        ///< bytes per component
+    int interleaved;                ///< U and V share one plane (semi-planar)
+    int depth;                      ///< bit depth of luma, including the shift of P010
+    ff_scene_sad_fn sad;            ///< line difference of the fielddiff metric
+
+    /* analysis window, set by ff_fmdif_comb_config() and ff_fmdif_comb_detect_borders() */
+    int win_x, win_y, win_w, win_h;
+    int roi_wx, roi_wy, roi_ww, roi_wh; ///< aligned analysis rectangle, clipped to the frame
+    int border_count;               ///< frames since the last border detection
+
+    /* misc buffers */
+    uint8_t *cmask_data[FMDIF_COMB_MAX_JOBS][4];
+    int cmask_linesize[FMDIF_COMB_MAX_JOBS][4];
+    int cmask_w, cmask_h;           ///< allocated size of the comb mask
+    int *c_array[FMDIF_COMB_MAX_JOBS];
+    int c_array_size;               ///< allocated number of entries of c_array
+    AVFrame *weave_pool[FMDIF_WEAVE_POOL_SIZE]; ///< buffers of the mP/mN weaves
+
+    /* kernels for blockx, blocky and cthresh, set by ff_fmdif_comb_alloc_blocks() */
+    FMDIFCountBlocksFn count_blocks;
+    FMDIFScoreLumaFn score_luma;
+} FMDIFCombContext;
+
+/**
+ * Set up for the frames of link, on the first configuration or a change of
+ * size or format. The scratch buffers only grow.
+ */
+int ff_fmdif_comb_config(FMDIFCombContext *s, const AVFilterLink *link);
+
+/**
+ * Grow the block counters and select the comb kernels after a change of
+ * blockx, blocky or cthresh.
+ */
+int ff_fmdif_comb_alloc_blocks(FMDIFCombContext *s, int w, int h);
+
+void ff_fmdif_comb_uninit(FMDIFCombContext *s);
+
+/**
+ * Weave the candidate match of the current frame src, whose line parity field
+ * is kept. mC returns a new reference to src, the others a buffer of the weave
+ * pool, or of link if none is free.
+ */
+AVFrame *ff_fmdif_comb_weave(FMDIFCombContext *s, AVFilterLink *link, int match, int field,
+                             const AVFrame *prv, AVFrame *src, const AVFrame *nxt);
+
+/**
+ * Detect the black borders of frame every borders frames, and restrict the
+ * analysis window to the picture inside them and the analysis rectangle.
+ * Return 1 if the window changed, so the cached scores are stale.
+ */
+int ff_fmdif_comb_detect_borders(FMDIFCombContext *s, const AVFrame *frame);
+
+/**
+ * Restore the window and the frame count of the border detection, as saved
+ * by an instance working on frames of the same size. Return 0 if they do not
+ * fit the analysis rectangle.
+ */
+int ff_fmdif_comb_set_borders(FMDIFCombContext *s, int count, int x, int y, int w, int h);
+
+/**
+ * Return the score of the analysis window of src for the selected metric,
+ * using the scratch buffers of job. With the comb metric, it is the highest
+ * number of combed pixels in a block. With fielddiff, it is the mean absolute
+ * difference between adjacent lines, in 1/FMDIF_FIELDDIFF_SCALE of an 8-bit
+ * level. Unless full is set, it is only the luma score, a lower bound, when
+ * ff_fmdif_comb_chromatol() is not 0.
+ */
+int ff_fmdif_comb_score(const FMDIFCombContext *s, const AVFrame *src, int job, int full);
+
+/**
+ * Return the margin below the threshold in which the luma scores are to be
+ * completed with the chroma, 0 if the scores are always complete.
+ */
+int ff_fmdif_comb_chromatol(const FMDIFCombContext *s);
+
+/**
+ * Return the score from which a candidate is taken as combed.
+ */
+int ff_fmdif_comb_thresh(const FMDIFCombContext *s);
+
+/**
+ * Score two candidates as parallel jobs, each with its own scratch buffers.
+ * nb_jobs must be FMDIF_COMB_MAX_JOBS.
+ */
+void ff_fmdif_comb_score2(AVFilterContext *ctx, const FMDIFCombContext *s,
+                          const AVFrame *a, const AVFrame *b, int full, int *score_a, int *score_b);
+
+#endif /* AVFILTER_FMDIF_COMB_H */
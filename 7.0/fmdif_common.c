@@ -0,0 +1,807 @@
+/*
+ * Front end shared by the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * Based on BobWeaver Deinterlacing Filter
+ * Copyright (C) 2016 Thomas Mundt <loudmax@yahoo.de>
+ *
+ * Based on YADIF (Yet Another Deinterlacing Filter)
+ * Copyright (C) 2006-2011 Michael Niedermayer <michaelni@gmx.at>
+ *               2010      James Darnley <james.darnley@gmail.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/file_open.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "avfilter.h"
+#include "ccfifo.h"
+#include "filters.h"
+#include "fmdif_common.h"
+#include "fmdif_yadif.h"
+#include "video.h"
+
+#define INPUT_MAIN     0
+
+// Round job start line down to multiple of 4 so that if filter_line3 exists
+// and the frame is a multiple of 4 high then filter_line will never be called
+static inline int job_start(const int jobnr, const int nb_jobs, const int h)
+{
+    return jobnr >= nb_jobs ? h : ((h * jobnr) / nb_jobs) & ~3;
+}
+
+static int filter_slice_bwdif(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+    FMDIFThreadData *td  = arg;
+    int linesize = yadif->cur->linesize[td->plane];
+    int clip_max = (1 << (yadif->csp->comp[td->plane].depth + yadif->csp->comp[td->plane].shift)) - 1;
+    int df = (yadif->csp->comp[td->plane].depth + 7) / 8;
+    int refs = linesize / df;
+    int slice_start = job_start(jobnr, nb_jobs, td->h);
+    int slice_end   = job_start(jobnr + 1, nb_jobs, td->h);
+    int y;
+
+    for (y = slice_start; y < slice_end; y++) {
+        if ((y ^ td->parity) & 1) {
+            uint8_t *prev = &yadif->prev->data[td->plane][y * linesize];
+            uint8_t *cur  = &yadif->cur ->data[td->plane][y * linesize];
+            uint8_t *next = &yadif->next->data[td->plane][y * linesize];
+            uint8_t *dst  = &td->frame->data[td->plane][y * td->frame->linesize[td->plane]];
+            if (yadif->current_field == YADIF_FIELD_END || fm->lowdelay) {
+                fm->dsp.filter_intra(dst, cur, td->w, (y + df) < td->h ? refs : -refs,
+                                y > (df - 1) ? -refs : refs,
+                                (y + 3*df) < td->h ? 3 * refs : -refs,
+                                y > (3*df - 1) ? -3 * refs : refs,
+                                td->parity ^ td->tff, clip_max);
+            } else if ((y < 4) || ((y + 5) > td->h)) {
+                fm->dsp.filter_edge(dst, prev, cur, next, td->w,
+                               (y + df) < td->h ? refs : -refs,
+                               y > (df - 1) ? -refs : refs,
+                               refs << 1, -(refs << 1),
+                               td->parity ^ td->tff, clip_max,
+                               (y < 2) || ((y + 3) > td->h) ? 0 : 1);
+            } else if (fm->dsp.filter_line3 && y + 2 < slice_end && y + 6 < td->h) {
+                fm->dsp.filter_line3(dst, td->frame->linesize[td->plane],
+                                prev, cur, next, linesize, td->w,
+                                td->parity ^ td->tff, clip_max);
+                y += 2;
+            } else {
+                fm->dsp.filter_line(dst, prev, cur, next, td->w,
+                               refs, -refs, refs << 1, -(refs << 1),
+                               3 * refs, -3 * refs, refs << 2, -(refs << 2),
+                               td->parity ^ td->tff, clip_max);
+            }
+        } else {
+            memcpy(&td->frame->data[td->plane][y * td->frame->linesize[td->plane]],
+                   &yadif->cur->data[td->plane][y * linesize], td->w * df);
+        }
+    }
+    return 0;
+}
+
+static int filter_slice_yadif(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FMDIFContext *fm = ctx->priv;
+    const FMDIFThreadData *td = arg;
+
+    ff_fmdif_yadif_slice(&fm->yadif, td, td->plane && fm->match.comb.interleaved, jobnr, nb_jobs);
+    return 0;
+}
+
+/* line doubling from the two neighbour lines of the same field only */
+static void filter_line_linear(void *dst1, const void *cur1, int w, int prefs, int mrefs)
+{
+    uint8_t *dst = dst1;
+    const uint8_t *cur = cur1;
+    int x;
+
+    for (x = 0; x < w; x++)
+        dst[x] = (cur[x + mrefs] + cur[x + prefs] + 1) >> 1;
+}
+
+static void filter_line_linear_16bit(void *dst1, const void *cur1, int w, int prefs, int mrefs)
+{
+    uint16_t *dst = dst1;
+    const uint16_t *cur = cur1;
+    int x;
+
+    mrefs /= 2;
+    prefs /= 2;
+    for (x = 0; x < w; x++)
+        dst[x] = (cur[x + mrefs] + cur[x + prefs] + 1) >> 1;
+}
+
+static int filter_slice_linear(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *s = &fm->yadif;
+    FMDIFThreadData *td  = arg;
+    int refs = s->cur->linesize[td->plane];
+    int df = (s->csp->comp[td->plane].depth + 7) / 8;
+    int slice_start = (td->h *  jobnr   ) / nb_jobs;
+    int slice_end   = (td->h * (jobnr+1)) / nb_jobs;
+    int y;
+
+    for (y = slice_start; y < slice_end; y++) {
+        uint8_t *cur = &s->cur->data[td->plane][y * refs];
+        uint8_t *dst = &td->frame->data[td->plane][y * td->frame->linesize[td->plane]];
+
+        if ((y ^ td->parity) & 1) {
+            (df > 1 ? filter_line_linear_16bit : filter_line_linear)(dst, cur, td->w,
+                                                                     y + 1 < td->h ? refs : -refs,
+                                                                     y ? -refs : refs);
+        } else {
+            memcpy(dst, cur, td->w * df);
+        }
+    }
+    return 0;
+}
+
+static int (*const filter_slices[FMDIF_INTERP_NB])(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs) = {
+    [FMDIF_INTERP_BWDIF]  = filter_slice_bwdif,
+    [FMDIF_INTERP_YADIF]  = filter_slice_yadif,
+    [FMDIF_INTERP_LINEAR] = filter_slice_linear,
+};
+
+/* ================ front end ================ */
+
+static void filter(AVFilterContext *ctx, AVFrame *dstpic,
+                   int parity, int tff)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+    FMDIFMatchContext *m = &fm->match;
+    FMDIFThreadData td = { .frame = dstpic, .parity = parity, .tff = tff };
+    const int is_second = parity ^ !tff;
+    const int prev_match = m->prev_match[0], fid = m->fid;
+    int i, match;
+
+    match = ff_fmdif_match_frame(ctx, m, ctx->inputs[INPUT_MAIN], yadif->prev, yadif->cur, yadif->next,
+                                 dstpic, tff, is_second);
+
+    /* drop the frame repeating the previous one, or the one at the position
+     * of the last repeat found until there is one in the cycle */
+    if (yadif->mode == FMDIF_MODE_SEND_FILM) {
+        const int repeat = match == mP && prev_match == mC;
+        const int phase  = fm->film_phase < 0 ? m->cycle - 1 : fm->film_phase;
+
+        if (repeat)
+            fm->film_phase = fid;
+        fm->film_drop = !fm->film_dropped && (repeat || fid == phase);
+        fm->film_dropped = fid < m->cycle - 1 && (fm->film_dropped || fm->film_drop);
+    }
+
+    if (match >= 0 || fm->film_drop || fm->warming) /* found matched field, dropped or warm-up */
+        return;
+
+    for (i = 0; i < fm->nb_planes; i++) {
+        int w = dstpic->width;
+        int h = dstpic->height;
+
+        if (i == 1 || i == 2) {
+            w = AV_CEIL_RSHIFT(w, yadif->csp->log2_chroma_w);
+            h = AV_CEIL_RSHIFT(h, yadif->csp->log2_chroma_h);
+        }
+        if (i == 1 && m->comb.interleaved)
+            w *= 2;
+
+        td.w     = w;
+        td.h     = h;
+        td.plane = i;
+
+        ff_filter_execute(ctx, filter_slices[fm->deinterlacer], &td, NULL,
+                          FFMIN((h+3)/4, ff_filter_get_nb_threads(ctx)));
+    }
+    if (yadif->current_field == YADIF_FIELD_END) {
+        yadif->current_field = YADIF_FIELD_NORMAL;
+    }
+}
+
+static int get_tff(const YADIFContext *yadif)
+{
+    if (yadif->parity == -1)
+        return (yadif->cur->flags & AV_FRAME_FLAG_INTERLACED) ?
+               !!(yadif->cur->flags & AV_FRAME_FLAG_TOP_FIELD_FIRST) : 1;
+    return yadif->parity ^ 1;
+}
+
+/* yadif passes these frames through, they are neither decided nor deinterlaced */
+static int is_passthrough(AVFilterContext *ctx)
+{
+    const FMDIFContext *fm = ctx->priv;
+    const YADIFContext *yadif = &fm->yadif;
+
+    return (yadif->deint && !(yadif->cur->flags & AV_FRAME_FLAG_INTERLACED)) || ctx->is_disabled ||
+           (yadif->deint && !(yadif->prev->flags & AV_FRAME_FLAG_INTERLACED) && yadif->prev->repeat_pict) ||
+           (yadif->deint && !(yadif->next->flags & AV_FRAME_FLAG_INTERLACED) && yadif->next->repeat_pict);
+}
+
+static int send_frame(AVFilterContext *ctx, AVFrame *out)
+{
+    FMDIFContext *fm = ctx->priv;
+    int ret;
+
+    ret = ff_ccfifo_inject(&fm->yadif.cc_fifo, out);
+    if (ret < 0) {
+        av_frame_free(&out);
+        return ret;
+    }
+    return ff_filter_frame(ctx->outputs[0], out);
+}
+
+/* send_film frames are timed from the first one at the output frame rate */
+static void set_film_pts(AVFilterContext *ctx, AVFrame *out)
+{
+    FMDIFContext *fm = ctx->priv;
+
+    if (fm->film_start_pts == AV_NOPTS_VALUE && out->pts != AV_NOPTS_VALUE)
+        fm->film_start_pts = av_rescale_q(out->pts, ctx->inputs[INPUT_MAIN]->time_base,
+                                          ctx->outputs[0]->time_base);
+    out->pts = fm->film_start_pts == AV_NOPTS_VALUE ? AV_NOPTS_VALUE :
+               fm->film_start_pts + fm->film_nb_out;
+    out->duration = 1;
+    fm->film_nb_out++;
+}
+
+/* decide the fields of cur and output them, or only decide them during the warm-up */
+static int filter_cur(AVFilterContext *ctx)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+    AVFilterLink *outlink = ctx->outputs[0];
+    const int tff = get_tff(yadif);
+    int warming = fm->nb_warmup < fm->warmup;
+    int64_t second_pts = AV_NOPTS_VALUE;
+    int is_second, ret = 0;
+
+    if (warming) {
+        fm->nb_warmup++;
+        /* a loaded state already holds the decisions of the warm-up frames
+         * before the last frame of the previous segment, or of all of them in
+         * lowdelay mode. That last frame was left undecided, see
+         * flush_frame(), and is decided and output here as in a single run. */
+        if (fm->state_loaded) {
+            yadif->current_field = YADIF_FIELD_NORMAL;
+            if (fm->lowdelay || fm->nb_warmup < fm->warmup)
+                return 0;
+            warming = 0;
+        }
+    }
+
+    if (is_passthrough(ctx)) {
+        AVFrame *out;
+
+        if (warming)
+            return 0;
+        out = av_frame_clone(yadif->cur);
+        if (!out)
+            return AVERROR(ENOMEM);
+        if (yadif->mode == FMDIF_MODE_SEND_FILM)
+            set_film_pts(ctx, out);
+        else if (out->pts != AV_NOPTS_VALUE)
+            out->pts *= 2;
+        return send_frame(ctx, out);
+    }
+
+    /* the second field is timed from the next frame, or from the previous
+     * one in lowdelay mode as the next is unknown */
+    if (yadif->cur->pts != AV_NOPTS_VALUE && !fm->lowdelay) {
+        if (yadif->next->pts != AV_NOPTS_VALUE)
+            second_pts = yadif->cur->pts + yadif->next->pts;
+    } else if (yadif->cur->pts != AV_NOPTS_VALUE) {
+        int64_t duration = yadif->cur->pts - yadif->prev->pts;
+
+        if (yadif->prev->pts == AV_NOPTS_VALUE || duration <= 0)
+            duration = yadif->cur->duration;
+        second_pts = yadif->cur->pts * 2 + duration;
+    }
+
+    fm->warming = warming;
+    for (is_second = 0; is_second <= (yadif->mode & 1); is_second++) {
+        AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        av_frame_copy_props(out, yadif->cur);
+        out->flags &= ~AV_FRAME_FLAG_INTERLACED;
+
+        /* the dropped frame is decided but never deinterlaced */
+        yadif->filter(ctx, out, tff ^ !is_second, tff);
+        if (warming || fm->film_drop) {
+            av_frame_free(&out);
+            continue;
+        }
+
+        if (yadif->mode == FMDIF_MODE_SEND_FILM)
+            set_film_pts(ctx, out);
+        else if (is_second)
+            out->pts = second_pts;
+        else if (out->pts != AV_NOPTS_VALUE)
+            out->pts *= 2;
+        ret = send_frame(ctx, out);
+        if (ret < 0)
+            break;
+    }
+    fm->warming = 0;
+    if (warming)
+        yadif->current_field = YADIF_FIELD_NORMAL;
+
+    return ret;
+}
+
+static int same_stride(const AVFrame *a, const AVFrame *b)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+        if (a->linesize[i] != b->linesize[i])
+            return 0;
+    return 1;
+}
+
+/* copy the picture of f to a buffer of the default linesizes */
+static int realloc_frame(AVFilterLink *link, AVFrame *f)
+{
+    AVFrame *dst = ff_default_get_video_buffer(link, f->width, f->height);
+    int ret;
+
+    if (!dst)
+        return AVERROR(ENOMEM);
+    ret = av_frame_copy_props(dst, f);
+    if (ret >= 0)
+        ret = av_frame_copy(dst, f);
+    if (ret >= 0) {
+        av_frame_unref(f);
+        av_frame_move_ref(f, dst);
+    }
+    av_frame_free(&dst);
+    return ret;
+}
+
+/* shift the frame window by frame, as yadif does */
+static int push_frame(AVFilterContext *ctx, AVFrame *frame)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+    AVFilterLink *inlink = ctx->inputs[INPUT_MAIN];
+    int ret;
+
+    ff_ccfifo_extract(&yadif->cc_fifo, frame);
+
+    av_frame_free(&yadif->prev);
+    if (fm->lowdelay) {
+        /* the frame is output as soon as it arrives, and also stands for the
+         * next frame: mN weaves degenerate to mC and are never scored */
+        av_frame_free(&yadif->next);
+        yadif->prev = yadif->cur;
+        yadif->cur  = frame;
+        yadif->next = av_frame_clone(frame);
+        if (!yadif->next)
+            return AVERROR(ENOMEM);
+        if (!yadif->prev) {
+            yadif->prev = av_frame_clone(frame);
+            if (!yadif->prev)
+                return AVERROR(ENOMEM);
+            yadif->current_field = YADIF_FIELD_END;
+        }
+    } else {
+        yadif->prev = yadif->cur;
+        yadif->cur  = yadif->next;
+        yadif->next = frame;
+        if (!yadif->cur) {
+            yadif->cur = av_frame_clone(yadif->next);
+            if (!yadif->cur)
+                return AVERROR(ENOMEM);
+            yadif->current_field = YADIF_FIELD_END;
+        }
+    }
+
+    /* the kernels and the weaves address the frames with the linesizes of cur */
+    if (!same_stride(yadif->next, yadif->cur)) {
+        av_log(ctx, AV_LOG_VERBOSE, "Reallocating frame due to differing stride\n");
+        if ((ret = realloc_frame(inlink, yadif->next)) < 0)
+            return ret;
+    }
+    if (!same_stride(yadif->next, yadif->cur) && (ret = realloc_frame(inlink, yadif->cur)) < 0)
+        return ret;
+    if (yadif->prev && !same_stride(yadif->next, yadif->prev) &&
+        (ret = realloc_frame(inlink, yadif->prev)) < 0)
+        return ret;
+    if (!same_stride(yadif->next, yadif->cur) ||
+        (yadif->prev && !same_stride(yadif->next, yadif->prev))) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to reallocate frame\n");
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+/* push the last frame again with itself as the next one, as yadif does at EOF */
+static int push_last_frame(AVFilterContext *ctx)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+    AVFrame *next;
+    int ret;
+
+    next = av_frame_clone(yadif->next);
+    if (!next)
+        return AVERROR(ENOMEM);
+    next->pts = yadif->next->pts * 2 - yadif->cur->pts;
+    yadif->current_field = YADIF_FIELD_END;
+
+    ret = push_frame(ctx, next);
+    if (ret < 0 || !yadif->prev)
+        return ret;
+    return filter_cur(ctx);
+}
+
+#define STATE_VERSION 4
+
+static int load_state(AVFilterContext *ctx)
+{
+    FMDIFContext *fm = ctx->priv;
+    FMDIFMatchContext *m = &fm->match;
+    char name[16];
+    int i, version, cycle, count, x, y, w, h, ret = 0;
+    FILE *f;
+
+    /* the frames before the first one to decide are needed for its window */
+    if (fm->warmup < (fm->lowdelay ? 1 : 2)) {
+        av_log(ctx, AV_LOG_ERROR, "state_in requires a warmup of at least %d frames\n",
+               fm->lowdelay ? 1 : 2);
+        return AVERROR(EINVAL);
+    }
+
+    f = avpriv_fopen_utf8(fm->state_in, "r");
+    if (!f) {
+        ret = AVERROR(errno);
+        av_log(ctx, AV_LOG_ERROR, "Cannot open state file %s\n", fm->state_in);
+        return ret;
+    }
+
+    if (fscanf(f, "%15s %d %d", name, &version, &cycle) != 3 ||
+        strcmp(name, ctx->filter->name) || version != STATE_VERSION) {
+        av_log(ctx, AV_LOG_ERROR, "%s is not a %s state file\n", fm->state_in, ctx->filter->name);
+        ret = AVERROR_INVALIDDATA;
+    } else if (cycle != m->cycle) {
+        av_log(ctx, AV_LOG_ERROR, "State saved with cycle %d instead of %d\n", cycle, m->cycle);
+        ret = AVERROR(EINVAL);
+    } else if (fscanf(f, "%d %d %d %d %d %d %d %d", &m->fid, &m->prev_match[0], &m->prev_match[1],
+                      &m->still_count[0], &m->still_count[1], &m->interlaced_run,
+                      &fm->film_dropped, &fm->film_phase) != 8 ||
+               m->fid < 0 || m->fid >= cycle ||
+               m->prev_match[0] < FMDIF_MATCH_UNKNOWN || m->prev_match[0] > mN ||
+               m->prev_match[1] < FMDIF_MATCH_UNKNOWN || m->prev_match[1] > mN ||
+               (unsigned)m->still_count[0] > cycle || (unsigned)m->still_count[1] > cycle ||
+               (unsigned)m->interlaced_run > cycle || (unsigned)fm->film_dropped > 1 ||
+               fm->film_phase < -1 || fm->film_phase >= cycle) {
+        ret = AVERROR_INVALIDDATA;
+    } else {
+        for (i = 0; i < cycle * 2 && !ret; i++)
+            if (fscanf(f, "%d", &m->last_match[i]) != 1 ||
+                m->last_match[i] < -1 || m->last_match[i] > mN)
+                ret = AVERROR_INVALIDDATA;
+        if (!ret && (fscanf(f, "%d %d %d %d %d %d",
+                            &m->cur_combed_score, &m->cur_combed_estimated, &m->cur_combed_full,
+                            &m->wf_combed_score, &m->wf_combed_estimated, &m->wf_combed_full) != 6 ||
+                     m->cur_combed_score < -1 || m->wf_combed_score < -1 ||
+                     (unsigned)m->cur_combed_estimated > 1 || (unsigned)m->cur_combed_full > 1 ||
+                     (unsigned)m->wf_combed_estimated > 1 || (unsigned)m->wf_combed_full > 1))
+            ret = AVERROR_INVALIDDATA;
+        if (!ret && (fscanf(f, "%d %d %d %d %d", &count, &x, &y, &w, &h) != 5 ||
+                     !ff_fmdif_comb_set_borders(&m->comb, count, x, y, w, h)))
+            ret = AVERROR_INVALIDDATA;
+    }
+    fclose(f);
+
+    if (ret == AVERROR_INVALIDDATA)
+        av_log(ctx, AV_LOG_ERROR, "Invalid state file %s\n", fm->state_in);
+    return ret;
+}
+
+static void save_state(AVFilterContext *ctx)
+{
+    FMDIFContext *fm = ctx->priv;
+    FMDIFMatchContext *m = &fm->match;
+    FILE *f;
+    int i;
+
+    f = avpriv_fopen_utf8(fm->state_out, "w");
+    if (!f) {
+        av_log(ctx, AV_LOG_ERROR, "Cannot open state file %s\n", fm->state_out);
+        return;
+    }
+
+    fprintf(f, "%s %d %d\n", ctx->filter->name, STATE_VERSION, m->cycle);
+    fprintf(f, "%d %d %d %d %d %d %d %d\n", m->fid, m->prev_match[0], m->prev_match[1],
+            m->still_count[0], m->still_count[1], m->interlaced_run, fm->film_dropped, fm->film_phase);
+    for (i = 0; i < m->cycle * 2; i++)
+        fprintf(f, "%d%c", m->last_match[i], i + 1 < m->cycle * 2 ? ' ' : '\n');
+    /* the scores kept for the next frame, its weave is made again if needed */
+    fprintf(f, "%d %d %d %d %d %d\n",
+            m->cur_combed_score, m->cur_combed_estimated, m->cur_combed_full,
+            m->wf_combed_score, m->wf_combed_estimated, m->wf_combed_full);
+    fprintf(f, "%d %d %d %d %d\n", m->comb.border_count,
+            m->comb.win_x, m->comb.win_y, m->comb.win_w, m->comb.win_h);
+    fclose(f);
+}
+
+/* the rhythm and the film timing go on across a mid-stream change of size */
+av_cold int ff_fmdif_init(AVFilterContext *ctx)
+{
+    FMDIFContext *fm = ctx->priv;
+
+    fm->film_phase = -1;
+    fm->film_start_pts = AV_NOPTS_VALUE;
+    return ff_fmdif_match_reset_rhythm(&fm->match);
+}
+
+av_cold void ff_fmdif_uninit(AVFilterContext *ctx)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+
+    av_frame_free(&yadif->prev);
+    av_frame_free(&yadif->cur );
+    av_frame_free(&yadif->next);
+    ff_ccfifo_uninit(&yadif->cc_fifo);
+
+    ff_fmdif_match_uninit(&fm->match);
+}
+
+const enum AVPixelFormat ff_fmdif_pix_fmts[] = {
+    AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P, AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_YUVJ411P, AV_PIX_FMT_YUVJ420P,
+    AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_YUV420P9, AV_PIX_FMT_YUV422P9, AV_PIX_FMT_YUV444P9,
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUV420P12, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV444P12,
+    AV_PIX_FMT_YUV420P14, AV_PIX_FMT_YUV422P14, AV_PIX_FMT_YUV444P14,
+    AV_PIX_FMT_YUV420P16, AV_PIX_FMT_YUV422P16, AV_PIX_FMT_YUV444P16,
+    AV_PIX_FMT_YUVA420P, AV_PIX_FMT_YUVA422P, AV_PIX_FMT_YUVA444P,
+    AV_PIX_FMT_YUVA420P9, AV_PIX_FMT_YUVA422P9, AV_PIX_FMT_YUVA444P9,
+    AV_PIX_FMT_YUVA420P10, AV_PIX_FMT_YUVA422P10, AV_PIX_FMT_YUVA444P10,
+    AV_PIX_FMT_YUVA420P16, AV_PIX_FMT_YUVA422P16, AV_PIX_FMT_YUVA444P16,
+    AV_PIX_FMT_GBRP, AV_PIX_FMT_GBRP9, AV_PIX_FMT_GBRP10,
+    AV_PIX_FMT_GBRP12, AV_PIX_FMT_GBRP14, AV_PIX_FMT_GBRP16,
+    AV_PIX_FMT_GBRAP, AV_PIX_FMT_GBRAP16,
+    AV_PIX_FMT_GRAY8, AV_PIX_FMT_GRAY16,
+    AV_PIX_FMT_NV12, AV_PIX_FMT_NV21, AV_PIX_FMT_NV16,
+    AV_PIX_FMT_P010, AV_PIX_FMT_P016,
+    AV_PIX_FMT_NONE
+};
+
+int ff_fmdif_config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    FMDIFContext *fm = ctx->priv;
+
+    return ff_fmdif_match_config(&fm->match, inlink);
+}
+
+int ff_fmdif_config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *s = &fm->yadif;
+    const AVFilterLink *inlink = ctx->inputs[INPUT_MAIN];
+    int ret;
+
+    ret = ff_yadif_config_output_common(outlink);
+    if (ret < 0)
+        return AVERROR(EINVAL);
+
+    if (s->mode == FMDIF_MODE_SEND_FILM && fm->lowdelay) {
+        av_log(ctx, AV_LOG_ERROR, "lowdelay is not supported in send_film mode\n");
+        return AVERROR(EINVAL);
+    }
+    if (s->mode == FMDIF_MODE_SEND_FILM) {
+        FilterLink *il = ff_filter_link(ctx->inputs[INPUT_MAIN]);
+        FilterLink *ol = ff_filter_link(outlink);
+
+        if (!il->frame_rate.num || !il->frame_rate.den) {
+            av_log(ctx, AV_LOG_ERROR, "send_film mode requires a known input frame rate\n");
+            return AVERROR(EINVAL);
+        }
+        ol->frame_rate = av_mul_q(il->frame_rate, (AVRational){ fm->match.cycle - 1, fm->match.cycle });
+        outlink->time_base = av_inv_q(ol->frame_rate);
+
+        /* the captions are spread over the decimated frames */
+        ff_ccfifo_uninit(&s->cc_fifo);
+        if ((ret = ff_ccfifo_init(&s->cc_fifo, ol->frame_rate, ctx)) < 0)
+            return ret;
+    }
+
+    s->csp = av_pix_fmt_desc_get(outlink->format);
+    s->filter = filter;
+
+    /* the bwdif kernels read two lines above and below */
+    if (fm->deinterlacer == FMDIF_INTERP_BWDIF &&
+        (AV_CEIL_RSHIFT(outlink->w, s->csp->log2_chroma_w) < 3 || AV_CEIL_RSHIFT(outlink->h, s->csp->log2_chroma_h) < 4)) {
+        av_log(ctx, AV_LOG_ERROR, "Video with planes less than 3 columns or 4 lines is not supported\n");
+        return AVERROR(EINVAL);
+    }
+
+    /* shifted samples such as P010 are filtered as 16 bit */
+    ff_bwdif_init_filter_line(&fm->dsp, s->csp->comp[0].depth + s->csp->comp[0].shift);
+    ff_fmdif_yadif_init(s);
+
+    fm->nb_planes = av_pix_fmt_count_planes(inlink->format);
+    fm->match.lowdelay = fm->lowdelay;
+
+    /* only at the start of the segment, not on a mid-stream change */
+    if (fm->state_in && !fm->state_loaded) {
+        if ((ret = load_state(ctx)) < 0)
+            return ret;
+        fm->state_loaded = 1;
+    }
+
+    return 0;
+}
+
+/* flush the frames of the previous size as at EOF, then restart */
+static int reconfigure(AVFilterContext *ctx, const AVFrame *frame)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+    AVFilterLink *inlink  = ctx->inputs[INPUT_MAIN];
+    AVFilterLink *outlink = ctx->outputs[0];
+    int ret;
+
+    /* the output format is negotiated once, only the size may follow the input */
+    if (frame->format != inlink->format) {
+        av_log(ctx, AV_LOG_ERROR, "Changing the pixel format from %s to %s is not supported\n",
+               av_get_pix_fmt_name(inlink->format), av_get_pix_fmt_name(frame->format));
+        return AVERROR(EINVAL);
+    }
+    av_log(ctx, AV_LOG_VERBOSE, "Input changed from %dx%d to %dx%d\n",
+           inlink->w, inlink->h, frame->width, frame->height);
+
+    /* nothing is pending in lowdelay mode */
+    if (!fm->lowdelay && (ret = push_last_frame(ctx)) < 0)
+        return ret;
+
+    av_frame_free(&yadif->prev);
+    av_frame_free(&yadif->cur );
+    av_frame_free(&yadif->next);
+    ff_ccfifo_uninit(&yadif->cc_fifo);
+
+    inlink->w = outlink->w = frame->width;
+    inlink->h = outlink->h = frame->height;
+    if ((ret = ff_fmdif_config_input(inlink)) < 0)
+        return ret;
+    return ff_fmdif_config_output(outlink);
+}
+
+static int filter_frame(AVFilterContext *ctx, AVFrame *frame)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+    const AVFilterLink *inlink = ctx->inputs[INPUT_MAIN];
+    int ret;
+
+    if (yadif->cur && (frame->width  != inlink->w || frame->height != inlink->h ||
+                       frame->format != inlink->format)) {
+        ret = reconfigure(ctx, frame);
+        if (ret < 0) {
+            av_frame_free(&frame);
+            return ret;
+        }
+    }
+
+    /* the previous segment already fed the warm-up frames to the border detection */
+    if (fm->state_loaded && fm->nb_warmup_in < fm->warmup) {
+        fm->nb_warmup_in++;
+    } else {
+        ff_fmdif_match_detect_borders(&fm->match, frame);
+    }
+
+    ret = push_frame(ctx, frame);
+    if (ret < 0 || !yadif->prev)
+        return ret;
+    return filter_cur(ctx);
+}
+
+static int flush_frame(AVFilterContext *ctx)
+{
+    FMDIFContext *fm = ctx->priv;
+    YADIFContext *yadif = &fm->yadif;
+
+    /* the last frame would be decided against a copy of itself, so it is left
+     * to the next segment, which decides and outputs it as its last warm-up
+     * frame. In lowdelay mode it was decided and output as usual already. */
+    if (fm->state_out) {
+        save_state(ctx);
+        return 0;
+    }
+
+    if (!yadif->cur || fm->lowdelay)
+        return 0;
+    return push_last_frame(ctx);
+}
+
+/* Both fields of a frame are output as soon as the next frame arrives, so
+ * nothing is left pending between two activations. */
+int ff_fmdif_activate(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink  = ctx->inputs[INPUT_MAIN];
+    AVFilterLink *outlink = ctx->outputs[0];
+    int nb_frames, nb_done = 0, ret, status;
+    int64_t pts;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    nb_frames = ff_inlink_queued_frames(inlink);
+    while (nb_frames--) {
+        AVFrame *frame;
+
+        ret = ff_inlink_consume_frame(inlink, &frame);
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            break;
+        ret = filter_frame(ctx, frame);
+        if (ret < 0)
+            return ret;
+        nb_done++;
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        if (status == AVERROR_EOF && (ret = flush_frame(ctx)) < 0)
+            return ret;
+        ff_outlink_set_status(outlink, status, av_rescale_q(pts, inlink->time_base, outlink->time_base));
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return nb_done ? 0 : FFERROR_NOT_READY;
+}
+
+int ff_fmdif_process_command(AVFilterContext *ctx, const char *cmd, const char *args,
+                             char *res, int res_len, int flags)
+{
+    FMDIFContext *fm = ctx->priv;
+    FMDIFMatchContext *m = &fm->match;
+    const AVFilterLink *inlink = ctx->inputs[INPUT_MAIN];
+    const int blockx = m->comb.blockx, blocky = m->comb.blocky, cycle = m->cycle;
+    int ret;
+
+    ret = ff_filter_process_command(ctx, cmd, args, res, res_len, flags);
+    if (ret < 0)
+        return ret;
+
+    /* the output frame rate depends on it */
+    if (m->cycle != cycle && fm->yadif.mode == FMDIF_MODE_SEND_FILM) {
+        av_log(ctx, AV_LOG_ERROR, "cycle cannot be changed in send_film mode\n");
+        m->cycle = cycle;
+        return AVERROR(EINVAL);
+    }
+
+    return ff_fmdif_match_update(m, inlink->w, inlink->h, blockx, blocky, cycle);
+}
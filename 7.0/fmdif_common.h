@@ -0,0 +1,126 @@
+/*
+ * Front end shared by the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FMDIF_COMMON_H
+#define AVFILTER_FMDIF_COMMON_H
+
+#include "libavutil/opt.h"
+#include "libavutil/pixfmt.h"
+#include "avfilter.h"
+#include "bwdifdsp.h"
+#include "fmdif_match.h"
+#include "yadif.h"
+
+#define FMDIF_MODE_SEND_FILM 4          ///< send one frame for each frame, dropping one per cycle
+
+/*
+ * Interpolators of the fields left unmatched. w3fdif is not one of them, as
+ * its C kernels are private to vf_w3fdif.c.
+ */
+enum FMDIFInterpolator {
+    FMDIF_INTERP_BWDIF,
+    FMDIF_INTERP_YADIF,
+    FMDIF_INTERP_LINEAR,
+    FMDIF_INTERP_NB,
+};
+
+/* fmdif and fmdif2 only differ in the defaults of their options */
+typedef struct FMDIFContext {
+    YADIFContext yadif;
+    BWDIFDSPContext dsp;
+    int nb_planes;                  ///< number of planes to deinterlace
+    int film_drop;                  ///< the current frame is dropped in send_film mode
+    int film_dropped;               ///< a frame was already dropped in the current cycle
+    int film_phase;                 ///< position in the cycle of the last repeated frame, -1 if none
+    int64_t film_start_pts;         ///< output pts of the first frame in send_film mode
+    int64_t film_nb_out;            ///< number of frames output in send_film mode
+    int nb_warmup;                  ///< number of frames decided for the warm-up
+    int nb_warmup_in;               ///< number of warm-up frames input with a loaded state
+    int warming;                    ///< the current frame is only decided for the warm-up
+    int state_loaded;               ///< state_in was already loaded
+
+    FMDIFMatchContext match;
+
+    /* options */
+    int deinterlacer;               ///< FMDIFInterpolator
+    char *state_in;
+    char *state_out;
+    int warmup;
+    int lowdelay;
+} FMDIFContext;
+
+extern const enum AVPixelFormat ff_fmdif_pix_fmts[];
+
+int ff_fmdif_init(AVFilterContext *ctx);
+
+int ff_fmdif_config_input(AVFilterLink *inlink);
+
+int ff_fmdif_config_output(AVFilterLink *outlink);
+
+int ff_fmdif_activate(AVFilterContext *ctx);
+
+int ff_fmdif_process_command(AVFilterContext *ctx, const char *cmd, const char *args,
+                             char *res, int res_len, int flags);
+
+void ff_fmdif_uninit(AVFilterContext *ctx);
+
+#define FMDIF_OFFSET(x) offsetof(FMDIFContext, x)
+#define FMDIF_FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+#define FMDIF_CONST(name, help, val, u) { name, help, 0, AV_OPT_TYPE_CONST, {.i64=val}, INT_MIN, INT_MAX, FMDIF_FLAGS, .unit = u }
+
+/* the options whose defaults are the same for both filters, but the deinterlacer */
+#define FMDIF_COMMON_OPTIONS(interp) \
+    { "combtol",  "refine at full resolution only the comb scores estimated this close to combpel, 0 to disable", FMDIF_OFFSET(match.comb.combtol), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FMDIF_FLAGS }, \
+    { "chromatol", "only add the chroma to the luma comb scores this close to combpel, 0 to always add it", FMDIF_OFFSET(match.comb.chromatol), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FMDIF_FLAGS }, \
+    { "metric",   "set the metric scoring the candidate matches", FMDIF_OFFSET(match.comb.metric), AV_OPT_TYPE_INT, {.i64=FMDIF_METRIC_COMB}, 0, 1, FMDIF_FLAGS, .unit = "metric" }, \
+    FMDIF_CONST("comb",      "fieldmatch comb score",                  FMDIF_METRIC_COMB,      "metric"), \
+    FMDIF_CONST("fielddiff", "mean difference of adjacent lines",      FMDIF_METRIC_FIELDDIFF, "metric"), \
+    { "fdthresh", "set the mean line difference from which a candidate is combed with the fielddiff metric", FMDIF_OFFSET(match.comb.fdthresh), AV_OPT_TYPE_DOUBLE, {.dbl=4}, 0, 255, FMDIF_FLAGS }, \
+    { "roi_x", "set the left edge of the analysis rectangle", FMDIF_OFFSET(match.comb.roi_x), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FMDIF_FLAGS }, \
+    { "roi_y", "set the top edge of the analysis rectangle", FMDIF_OFFSET(match.comb.roi_y), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FMDIF_FLAGS }, \
+    { "roi_w", "set the width of the analysis rectangle, 0 to reach the right edge", FMDIF_OFFSET(match.comb.roi_w), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FMDIF_FLAGS }, \
+    { "roi_h", "set the height of the analysis rectangle, 0 to reach the bottom edge", FMDIF_OFFSET(match.comb.roi_h), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FMDIF_FLAGS }, \
+    { "borders", "set the number of frames between black border detections, 0 to disable", FMDIF_OFFSET(match.comb.borders), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FMDIF_FLAGS }, \
+    { "borderthresh", "set the mean luma of a black border line", FMDIF_OFFSET(match.comb.borderthresh), AV_OPT_TYPE_INT, {.i64=32}, 0, 255, FMDIF_FLAGS }, \
+    { "cycle",    "set the number of frames you want to keep the rhythm", FMDIF_OFFSET(match.cycle), AV_OPT_TYPE_INT, {.i64 = 5}, 2, 25, FMDIF_FLAGS|AV_OPT_FLAG_RUNTIME_PARAM }, \
+    { "apply",    "follow the field matching exported by fmdifanalyze",  FMDIF_OFFSET(match.apply), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FMDIF_FLAGS }, \
+    { "hints",    "follow the frame classification exported by idet",    FMDIF_OFFSET(match.hints), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FMDIF_FLAGS }, \
+    \
+    { "pulldown", "specify how to use soft pulldown flags", FMDIF_OFFSET(match.pulldown), AV_OPT_TYPE_INT, {.i64=FMDIF_PULLDOWN_OFF}, 0, 2, FMDIF_FLAGS, .unit = "pulldown" }, \
+    FMDIF_CONST("off",   "ignore the flags",                      FMDIF_PULLDOWN_OFF,   "pulldown"), \
+    FMDIF_CONST("check", "follow the flags if not combed",        FMDIF_PULLDOWN_CHECK, "pulldown"), \
+    FMDIF_CONST("trust", "follow the flags without comb scoring", FMDIF_PULLDOWN_TRUST, "pulldown"), \
+    \
+    { "deinterlacer", "specify the interpolator of the fields left unmatched", FMDIF_OFFSET(deinterlacer), AV_OPT_TYPE_INT, {.i64=interp}, 0, FMDIF_INTERP_NB-1, FMDIF_FLAGS, .unit = "deinterlacer" }, \
+    FMDIF_CONST("bwdif",  "bob weaver deinterlacing",           FMDIF_INTERP_BWDIF,  "deinterlacer"), \
+    FMDIF_CONST("yadif",  "yet another deinterlacing",          FMDIF_INTERP_YADIF,  "deinterlacer"), \
+    FMDIF_CONST("linear", "linear interpolation from the field", FMDIF_INTERP_LINEAR, "deinterlacer"), \
+    \
+    { "prescreen", "set the mean field difference below which a field is taken as repeated", FMDIF_OFFSET(match.prescreen), AV_OPT_TYPE_DOUBLE, {.dbl = 0}, 0, 255, FMDIF_FLAGS }, \
+    { "stillthresh", "set the mean frame difference below which the decision of the previous frame is reused", FMDIF_OFFSET(match.stillthresh), AV_OPT_TYPE_DOUBLE, {.dbl = 0}, 0, 255, FMDIF_FLAGS }, \
+    \
+    { "state_in",  "load the cadence state saved by a previous segment from a file", FMDIF_OFFSET(state_in),  AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FMDIF_FLAGS }, \
+    { "state_out", "save the cadence state at the end of the segment to a file",     FMDIF_OFFSET(state_out), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FMDIF_FLAGS }, \
+    { "warmup",    "set the number of leading frames only decided, not output",     FMDIF_OFFSET(warmup),    AV_OPT_TYPE_INT,    {.i64 = 0},    0, INT_MAX, FMDIF_FLAGS }, \
+    { "lowdelay",  "output each frame on arrival, without matching the next one",   FMDIF_OFFSET(lowdelay),  AV_OPT_TYPE_BOOL,   {.i64 = 0},    0, 1, FMDIF_FLAGS }, \
+    { "parallel",  "score both match candidates at once as parallel jobs",         FMDIF_OFFSET(match.parallel), AV_OPT_TYPE_BOOL, {.i64 = 0},  0, 1, FMDIF_FLAGS }
+
+#endif /* AVFILTER_FMDIF_COMMON_H */
@@ -0,0 +1,611 @@
+/*
+ * Comb detection kernels, field match decision and yadif line kernels of
+ * the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * Based on vf_fieldmatch:
+ * Copyright (c) 2012 Fredrik Mellbin
+ * Copyright (c) 2013 Clément Bœsch
+ *
+ * Based on vf_yadif:
+ * Copyright (C) 2006-2011 Michael Niedermayer <michaelni@gmx.at>
+ *               2010      James Darnley <james.darnley@gmail.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmdif_core.h"
+
+/* av_always_inline, which this file cannot take from libavutil */
+#if defined(__GNUC__)
+#define CORE_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#define CORE_ALWAYS_INLINE inline
+#endif
+
+/* FFMIN, FFMAX and their three argument forms */
+#define CORE_MIN(a, b) ((a) > (b) ? (b) : (a))
+#define CORE_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define CORE_MIN3(a, b, c) CORE_MIN(CORE_MIN(a, b), c)
+#define CORE_MAX3(a, b, c) CORE_MAX(CORE_MAX(a, b), c)
+
+/*
+ * The comb mask is computed without data dependent branches so that the
+ * kernels below vectorize: each test yields 0 or 1, they are combined with
+ * bitwise ands and the result turned into 0x00 or 0xff. The rows above and
+ * below the picture are mirrored into it, which is what the special cases of
+ * the first and last two lines used to do.
+ */
+static CORE_ALWAYS_INLINE int comb_mask_px(int p, int up1, int dn1, int up2, int dn2,
+                                           int cthresh, int cthresh6)
+{
+    return -((abs(p - up1) > cthresh) &
+             (abs(p - dn1) > cthresh) &
+             (abs(4 * p - 3 * (up1 + dn1) + (up2 + dn2)) > cthresh6));
+}
+
+static CORE_ALWAYS_INLINE void comb_mask_row(const uint8_t *srcp, const uint8_t *up1,
+                                             const uint8_t *dn1, const uint8_t *up2,
+                                             const uint8_t *dn2, uint8_t *cmkp,
+                                             int width, int step, int cthresh)
+{
+    const int cthresh6 = cthresh * 6;
+    int x;
+
+    for (x = 0; x < width; x++)
+        cmkp[x] = comb_mask_px(srcp[x * step], up1[x * step], dn1[x * step],
+                               up2[x * step], dn2[x * step], cthresh, cthresh6);
+}
+
+/* byte offsets of the lines 1 and 2 rows above and below y, mirrored at the edges */
+static void mirror_rows(int y, int height, ptrdiff_t linesize, ptrdiff_t off[4])
+{
+    off[0] = (y > 0          ? -1 :  1) * linesize;
+    off[1] = (y < height - 1 ?  1 : -1) * linesize;
+    off[2] = (y > 1          ? -2 :  2) * linesize;
+    off[3] = (y < height - 2 ?  2 : -2) * linesize;
+}
+
+void ff_fmdif_comb_mask_plane(uint8_t *cmkp, ptrdiff_t cmk_linesize,
+                              const uint8_t *srcp, ptrdiff_t src_linesize,
+                              int width, int height, int step, int cthresh)
+{
+    int y;
+
+    if (cthresh < 0) {
+        for (y = 0; y < height; y++)
+            memset(cmkp + y * cmk_linesize, 0xff, width);
+        return;
+    }
+    /* [1 -3 4 -3 1] vertical filter, every mask byte is written */
+    for (y = 0; y < height; y++) {
+        const uint8_t *srcy = srcp + y * src_linesize;
+        ptrdiff_t off[4];
+
+        mirror_rows(y, height, src_linesize, off);
+        /* constant steps for planar, and 8 and 16-bit semi-planar chroma */
+#define COMB_MASK_ROW(step)                                                                 \
+        comb_mask_row(srcy, srcy + off[0], srcy + off[1], srcy + off[2], srcy + off[3],    \
+                      cmkp + y * cmk_linesize, width, step, cthresh)
+        switch (step) {
+        case 1:  COMB_MASK_ROW(1);    break;
+        case 2:  COMB_MASK_ROW(2);    break;
+        case 4:  COMB_MASK_ROW(4);    break;
+        default: COMB_MASK_ROW(step); break;
+        }
+    }
+}
+
+void ff_fmdif_comb_mask_line(uint8_t *cmkp, const uint8_t *srcp, ptrdiff_t src_linesize, int step,
+                             int y, int height, int x_start, int x_end, int x_step, int cthresh)
+{
+    const int cthresh6 = cthresh * 6;
+    ptrdiff_t off[4];
+    int x;
+
+    mirror_rows(y, height, src_linesize, off);
+    srcp += y * src_linesize;
+    for (x = x_start; x < x_end; x += x_step) {
+        const uint8_t *p = srcp + x * step;
+        cmkp[x] |= comb_mask_px(p[0], p[off[0]], p[off[1]], p[off[2]], p[off[3]], cthresh, cthresh6);
+    }
+}
+
+void ff_fmdif_comb_dilate_chroma(uint8_t *cmkp, ptrdiff_t cmk_linesize,
+                                 const uint8_t *cmkpU, const uint8_t *cmkpV,
+                                 ptrdiff_t cmk_linesizeUV, int width, int height)
+{
+    uint8_t *cmkpp  = cmkp - cmk_linesize;
+    uint8_t *cmkpn  = cmkp + cmk_linesize;
+    uint8_t *cmkpnn = cmkp + cmk_linesize * 2;
+    int x, y;
+
+    /* two luma lines per chroma line */
+    cmk_linesize <<= 1;
+    for (y = 1; y < height - 1; y++) {
+        cmkpp  += cmk_linesize;
+        cmkp   += cmk_linesize;
+        cmkpn  += cmk_linesize;
+        cmkpnn += cmk_linesize;
+        cmkpV  += cmk_linesizeUV;
+        cmkpU  += cmk_linesizeUV;
+        for (x = 1; x < width - 1; x++) {
+#define HAS_FF_AROUND(p, lz) (p[(x)-1 - (lz)] == 0xff || p[(x) - (lz)] == 0xff || p[(x)+1 - (lz)] == 0xff || \
+                              p[(x)-1       ] == 0xff ||                          p[(x)+1       ] == 0xff || \
+                              p[(x)-1 + (lz)] == 0xff || p[(x) + (lz)] == 0xff || p[(x)+1 + (lz)] == 0xff)
+            if ((cmkpV[x] == 0xff && HAS_FF_AROUND(cmkpV, cmk_linesizeUV)) ||
+                (cmkpU[x] == 0xff && HAS_FF_AROUND(cmkpU, cmk_linesizeUV))) {
+                cmkp [2 * x] = cmkp [2 * x + 1] = 0xff;
+                cmkpn[2 * x] = cmkpn[2 * x + 1] = 0xff;
+                if (y&1) cmkpp [2 * x] = cmkpp [2 * x + 1] = 0xff;
+                else     cmkpnn[2 * x] = cmkpnn[2 * x + 1] = 0xff;
+            }
+        }
+    }
+}
+
+int ff_fmdif_comb_blocks_size(int width, int height, int blockx, int blocky)
+{
+    return ((((width + blockx/2)/blockx)+1) *
+            (((height + blocky/2)/blocky)+1)) * 4;
+}
+
+/* how count_combed_blocks_tmpl() gets the luma mask */
+enum {
+    COUNT_MASK,                     ///< count the mask as built by the caller
+    COUNT_FUSED,                    ///< build each mask row just before it is counted
+    COUNT_FULL,                     ///< negative cthresh, every pixel is combed
+};
+
+/*
+ * Highest number of combed pixels in a block of the luma mask. The fused
+ * version masks the rows of a block band right before counting them, while
+ * they are still in cache, and leaves the whole mask built as
+ * ff_fmdif_comb_mask_plane() does. The full one counts without a mask.
+ */
+static CORE_ALWAYS_INLINE int count_combed_blocks_tmpl(const int mode, uint8_t *cmask, ptrdiff_t cmk_linesize,
+                                                       const uint8_t *srcp, ptrdiff_t src_linesize,
+                                                       int width, int height, int blockx, int blocky,
+                                                       const int step, int cthresh, int *c_array)
+{
+    const int xhalf = blockx/2;
+    const int yhalf = blocky/2;
+    const uint8_t *cmkp = cmask + cmk_linesize;
+    const int xblocks = ((width+xhalf)/blockx) + 1;
+    const int xblocks4 = xblocks<<2;
+    const int yblocks = ((height+yhalf)/blocky) + 1;
+    const int arraysize = (xblocks*yblocks)<<2;
+    int      heighta = (height/(blocky/2))*(blocky/2);
+    const int widtha = (width /(blockx/2))*(blockx/2);
+    int x, y, max_v = 0, masked = 0;
+
+    if (heighta == height)
+        heighta = height - yhalf;
+    memset(c_array, 0, arraysize * sizeof(*c_array));
+
+#define C_ARRAY_ADD(v) do {                         \
+    const int box1 = (x / blockx) * 4;              \
+    const int box2 = ((x + xhalf) / blockx) * 4;    \
+    c_array[temp1 + box1    ] += v;                 \
+    c_array[temp1 + box2 + 1] += v;                 \
+    c_array[temp2 + box1 + 2] += v;                 \
+    c_array[temp2 + box2 + 3] += v;                 \
+} while (0)
+
+/* the mask only holds 0x00 and 0xff, so this is 1 when all three are set */
+#define COMBED3(p, x) (mode == COUNT_FULL ? 1 : \
+                       (p)[(x) - cmk_linesize] & (p)[x] & (p)[(x) + cmk_linesize] & 1)
+
+/* the mask rows below end, as the rows around y are read for the row y */
+#define MASK_ROWS(end) do {                                                 \
+    if (mode == COUNT_FUSED) {                                              \
+        for (; masked < CORE_MIN(end, height); masked++) {                \
+            const uint8_t *srcy = srcp + masked * src_linesize;             \
+            ptrdiff_t off[4];                                               \
+            mirror_rows(masked, height, src_linesize, off);                 \
+            comb_mask_row(srcy, srcy + off[0], srcy + off[1], srcy + off[2],\
+                          srcy + off[3], cmask + masked * cmk_linesize,     \
+                          width, step, cthresh);                            \
+        }                                                                   \
+    }                                                                       \
+} while (0)
+
+#define VERTICAL_HALF(y_start, y_end) do {                                  \
+    MASK_ROWS(y_end + 1);                                                   \
+    for (y = y_start; y < y_end; y++) {                                     \
+        const int temp1 = (y / blocky) * xblocks4;                          \
+        const int temp2 = ((y + yhalf) / blocky) * xblocks4;                \
+        for (x = 0; x < width; x++)                                         \
+            C_ARRAY_ADD(COMBED3(cmkp, x));                                  \
+        cmkp += cmk_linesize;                                               \
+    }                                                                       \
+} while (0)
+
+    VERTICAL_HALF(1, yhalf);
+
+    for (y = yhalf; y < heighta; y += yhalf) {
+        const int temp1 = (y / blocky) * xblocks4;
+        const int temp2 = ((y + yhalf) / blocky) * xblocks4;
+
+        MASK_ROWS(y + yhalf + 1);
+        for (x = 0; x < widtha; x += xhalf) {
+            const uint8_t *cmkp_tmp = cmkp + x;
+            int u, v, sum = 0;
+            for (u = 0; u < yhalf; u++) {
+                for (v = 0; v < xhalf; v++)
+                    sum += COMBED3(cmkp_tmp, v);
+                cmkp_tmp += cmk_linesize;
+            }
+            C_ARRAY_ADD(sum);
+        }
+
+        for (x = widtha; x < width; x++) {
+            const uint8_t *cmkp_tmp = cmkp + x;
+            int u, sum = 0;
+            for (u = 0; u < yhalf; u++) {
+                sum += COMBED3(cmkp_tmp, 0);
+                cmkp_tmp += cmk_linesize;
+            }
+            C_ARRAY_ADD(sum);
+        }
+        cmkp += cmk_linesize * yhalf;
+    }
+
+    VERTICAL_HALF(heighta, height - 1);
+
+    for (x = 0; x < arraysize; x++)
+        if (c_array[x] > max_v)
+            max_v = c_array[x];
+    return max_v;
+}
+
+/*
+ * Specialized for the common block sizes, so that the window loops are
+ * unrolled and the block divisions turned into shifts, and for each way to
+ * get the mask: counting the one of the caller, which then also holds the
+ * chroma, fusing the luma mask for 8-bit and 16-bit high byte samples, and
+ * counting a negative cthresh without any mask. The generic versions handle
+ * any other block size.
+ */
+#define COMB_BLOCKS_FUNCS(name, bx, by)                                                         \
+static int count_combed_blocks_##name(const uint8_t *cmask, ptrdiff_t cmk_linesize,             \
+                                      int width, int height, int blockx, int blocky,            \
+                                      int *c_array)                                             \
+{                                                                                               \
+    (void)blockx; (void)blocky;                                                                 \
+    return count_combed_blocks_tmpl(COUNT_MASK, (uint8_t *)cmask, cmk_linesize, NULL, 0,        \
+                                    width, height, bx, by, 0, 0, c_array);                      \
+}                                                                                               \
+                                                                                                \
+static int score_luma_##name##_8(uint8_t *cmask, ptrdiff_t cmk_linesize,                        \
+                                 const uint8_t *srcp, ptrdiff_t src_linesize,                   \
+                                 int width, int height, int blockx, int blocky,                 \
+                                 int cthresh, int *c_array)                                     \
+{                                                                                               \
+    (void)blockx; (void)blocky;                                                                 \
+    return count_combed_blocks_tmpl(COUNT_FUSED, cmask, cmk_linesize, srcp, src_linesize,       \
+                                    width, height, bx, by, 1, cthresh, c_array);                \
+}                                                                                               \
+                                                                                                \
+static int score_luma_##name##_16(uint8_t *cmask, ptrdiff_t cmk_linesize,                       \
+                                  const uint8_t *srcp, ptrdiff_t src_linesize,                  \
+                                  int width, int height, int blockx, int blocky,                \
+                                  int cthresh, int *c_array)                                    \
+{                                                                                               \
+    (void)blockx; (void)blocky;                                                                 \
+    return count_combed_blocks_tmpl(COUNT_FUSED, cmask, cmk_linesize, srcp, src_linesize,       \
+                                    width, height, bx, by, 2, cthresh, c_array);                \
+}                                                                                               \
+                                                                                                \
+static int score_luma_##name##_full(uint8_t *cmask, ptrdiff_t cmk_linesize,                     \
+                                    const uint8_t *srcp, ptrdiff_t src_linesize,                \
+                                    int width, int height, int blockx, int blocky,              \
+                                    int cthresh, int *c_array)                                  \
+{                                                                                               \
+    (void)blockx; (void)blocky; (void)srcp; (void)src_linesize; (void)cthresh;                  \
+    return count_combed_blocks_tmpl(COUNT_FULL, cmask, cmk_linesize, NULL, 0,                   \
+                                    width, height, bx, by, 0, 0, c_array);                      \
+}
+
+COMB_BLOCKS_FUNCS(16x16, 16, 16)
+COMB_BLOCKS_FUNCS(16x32, 16, 32)
+COMB_BLOCKS_FUNCS(32x32, 32, 32)
+COMB_BLOCKS_FUNCS(c, blockx, blocky)
+
+#define COMB_BLOCKS_ENTRY(name, bx, by) \
+    { bx, by, count_combed_blocks_##name, score_luma_##name##_8, score_luma_##name##_16, score_luma_##name##_full }
+
+static const struct {
+    int blockx, blocky;
+    FMDIFCountBlocksFn count;
+    FMDIFScoreLumaFn luma8, luma16, full;
+} comb_blocks_funcs[] = {
+    COMB_BLOCKS_ENTRY(16x16, 16, 16),
+    COMB_BLOCKS_ENTRY(16x32, 16, 32),
+    COMB_BLOCKS_ENTRY(32x32, 32, 32),
+    COMB_BLOCKS_ENTRY(c,      0,  0),
+};
+
+/* the entry of blockx x blocky, or the generic last one */
+static int find_comb_blocks_funcs(int blockx, int blocky)
+{
+    int i;
+
+    for (i = 0; i < (int)(sizeof(comb_blocks_funcs) / sizeof(*comb_blocks_funcs)) - 1; i++)
+        if (comb_blocks_funcs[i].blockx == blockx && comb_blocks_funcs[i].blocky == blocky)
+            break;
+    return i;
+}
+
+FMDIFCountBlocksFn ff_fmdif_comb_count_blocks_fn(int blockx, int blocky)
+{
+    return comb_blocks_funcs[find_comb_blocks_funcs(blockx, blocky)].count;
+}
+
+FMDIFScoreLumaFn ff_fmdif_comb_score_luma_fn(int blockx, int blocky, int step, int cthresh)
+{
+    const int i = find_comb_blocks_funcs(blockx, blocky);
+
+    if (cthresh < 0)
+        return comb_blocks_funcs[i].full;
+    return step == 1 ? comb_blocks_funcs[i].luma8 : comb_blocks_funcs[i].luma16;
+}
+
+/* a luma only score this close below combpel may reach it with the chroma */
+static int is_near(int score, int full, int combpel, int tol)
+{
+    return !full && score < combpel && score >= combpel - tol;
+}
+
+int ff_fmdif_match_field(int last_match, int is_second, int thresh, int halve, int tol,
+                         FMDIFScoreFn score, void *opaque)
+{
+    const int pn = is_second ? mN : mP;
+    /* if the last is unmatched, combpel should be half */
+    const int combpel = halve && last_match < 0 ? thresh / 2 : thresh;
+    int match = -1, p1, p2, s1, s2, full1 = 0, full2;
+
+    /* the last matched frame is priority */
+    switch (last_match) {
+    case mP:
+    case mN:
+        p1 = pn;
+        p2 = mC;
+        if (score(opaque, p1, &full1) >= 0)
+            break;
+        /* continue if there is no frame to weave with */
+        /* fall through */
+    case mC:
+    default:
+        p1 = mC;
+        p2 = pn;
+        break;
+    }
+
+    /* evaluate combed scores, the second candidate only if needed */
+    full1 = 0;
+    s1 = score(opaque, p1, &full1);
+    if (is_near(s1, full1, combpel, tol)) {
+        full1 = 1;
+        s1 = score(opaque, p1, &full1);
+    }
+    if (s1 < combpel && last_match >= 0)
+        return p1;
+
+    full2 = full1;
+    s2 = score(opaque, p2, &full2);
+    if (s2 < 0)
+        return -1;
+    /* the candidates are compared with the same scoring */
+    if (full1 != full2 || is_near(s2, full2, combpel, tol)) {
+        full1 = full2 = 1;
+        s1 = score(opaque, p1, &full1);
+        s2 = score(opaque, p2, &full2);
+    }
+
+    /* if both are no comb, lower is better */
+    if (s1 < combpel && s1 <= s2)
+        match = p1;
+    else if (s2 < combpel)
+        match = p2;
+    return match;
+}
+
+/* yadif interpolation, see vf_yadif.c */
+
+#define CHECK(j)\
+    {   int score = abs(cur[mrefs - 1 + (j)] - cur[prefs - 1 - (j)])\
+                  + abs(cur[mrefs  +(j)] - cur[prefs  -(j)])\
+                  + abs(cur[mrefs + 1 + (j)] - cur[prefs + 1 - (j)]);\
+        if (score < spatial_score) {\
+            spatial_score= score;\
+            spatial_pred= (cur[mrefs  +(j)] + cur[prefs  -(j)])>>1;\
+
+/* The is_not_edge argument here controls when the code will enter a branch
+ * which reads up to and including x-3 and x+3. */
+
+#define FILTER(start, end, is_not_edge) \
+    for (x = start;  x < end; x++) { \
+        int c = cur[mrefs]; \
+        int d = (prev2[0] + next2[0])>>1; \
+        int e = cur[prefs]; \
+        int temporal_diff0 = abs(prev2[0] - next2[0]); \
+        int temporal_diff1 =(abs(prev[mrefs] - c) + abs(prev[prefs] - e) )>>1; \
+        int temporal_diff2 =(abs(next[mrefs] - c) + abs(next[prefs] - e) )>>1; \
+        int diff = CORE_MAX3(temporal_diff0 >> 1, temporal_diff1, temporal_diff2); \
+        int spatial_pred = (c+e) >> 1; \
+ \
+        if (is_not_edge) {\
+            int spatial_score = abs(cur[mrefs - 1] - cur[prefs - 1]) + abs(c-e) \
+                              + abs(cur[mrefs + 1] - cur[prefs + 1]) - 1; \
+            CHECK(-1) CHECK(-2) }} }} \
+            CHECK( 1) CHECK( 2) }} }} \
+        }\
+ \
+        if (!(mode&2)) { \
+            int b = (prev2[2 * mrefs] + next2[2 * mrefs])>>1; \
+            int f = (prev2[2 * prefs] + next2[2 * prefs])>>1; \
+            int max = CORE_MAX3(d - e, d - c, CORE_MIN(b - c, f - e)); \
+            int min = CORE_MIN3(d - e, d - c, CORE_MAX(b - c, f - e)); \
+ \
+            diff = CORE_MAX3(diff, min, -max); \
+        } \
+ \
+        if (spatial_pred > d + diff) \
+           spatial_pred = d + diff; \
+        else if (spatial_pred < d - diff) \
+           spatial_pred = d - diff; \
+ \
+        dst[0] = spatial_pred; \
+ \
+        dst++; \
+        cur++; \
+        prev++; \
+        next++; \
+        prev2++; \
+        next2++; \
+    }
+
+void ff_fmdif_yadif_line(void *dst1, void *prev1, void *cur1, void *next1,
+                         int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint8_t *dst  = dst1;
+    uint8_t *prev = prev1;
+    uint8_t *cur  = cur1;
+    uint8_t *next = next1;
+    int x;
+    uint8_t *prev2 = parity ? prev : cur ;
+    uint8_t *next2 = parity ? cur  : next;
+
+    /* The function is called with the pointers already pointing to data[3] and
+     * with 6 subtracted from the width.  This allows the FILTER macro to be
+     * called so that it processes all the pixels normally.  A constant value of
+     * true for is_not_edge lets the compiler ignore the if statement. */
+    FILTER(0, w, 1)
+}
+
+void ff_fmdif_yadif_edges(void *dst1, void *prev1, void *cur1, void *next1,
+                          int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint8_t *dst  = dst1;
+    uint8_t *prev = prev1;
+    uint8_t *cur  = cur1;
+    uint8_t *next = next1;
+    int x;
+    uint8_t *prev2 = parity ? prev : cur ;
+    uint8_t *next2 = parity ? cur  : next;
+
+    const int edge = FMDIF_YADIF_MAX_ALIGN - 1;
+    int offset = CORE_MAX(w - edge, 3);
+
+    /* Only edge pixels need to be processed here.  A constant value of false
+     * for is_not_edge should let the compiler ignore the whole branch. */
+    FILTER(0, CORE_MIN(3, w), 0)
+
+    dst  = (uint8_t*)dst1  + offset;
+    prev = (uint8_t*)prev1 + offset;
+    cur  = (uint8_t*)cur1  + offset;
+    next = (uint8_t*)next1 + offset;
+    prev2 = (uint8_t*)(parity ? prev : cur);
+    next2 = (uint8_t*)(parity ? cur  : next);
+
+    FILTER(offset, w - 3, 1)
+    offset = CORE_MAX(offset, w - 3);
+    FILTER(offset, w, 0)
+}
+
+/* Semi-planar chroma interleaves U and V, which the edge directed spatial
+ * prediction would mix, so only the vertical and temporal checks are used. */
+void ff_fmdif_yadif_line_interleaved(void *dst1, void *prev1, void *cur1, void *next1,
+                                     int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint8_t *dst  = dst1;
+    uint8_t *prev = prev1;
+    uint8_t *cur  = cur1;
+    uint8_t *next = next1;
+    int x;
+    uint8_t *prev2 = parity ? prev : cur ;
+    uint8_t *next2 = parity ? cur  : next;
+
+    FILTER(0, w, 0)
+}
+
+void ff_fmdif_yadif_line_16bit(void *dst1, void *prev1, void *cur1, void *next1,
+                               int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint16_t *dst  = dst1;
+    uint16_t *prev = prev1;
+    uint16_t *cur  = cur1;
+    uint16_t *next = next1;
+    int x;
+    uint16_t *prev2 = parity ? prev : cur ;
+    uint16_t *next2 = parity ? cur  : next;
+    mrefs /= 2;
+    prefs /= 2;
+
+    FILTER(0, w, 1)
+}
+
+void ff_fmdif_yadif_edges_16bit(void *dst1, void *prev1, void *cur1, void *next1,
+                                int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint16_t *dst  = dst1;
+    uint16_t *prev = prev1;
+    uint16_t *cur  = cur1;
+    uint16_t *next = next1;
+    int x;
+    uint16_t *prev2 = parity ? prev : cur ;
+    uint16_t *next2 = parity ? cur  : next;
+
+    const int edge = FMDIF_YADIF_MAX_ALIGN / 2 - 1;
+    int offset = CORE_MAX(w - edge, 3);
+
+    mrefs /= 2;
+    prefs /= 2;
+
+    FILTER(0,  CORE_MIN(3, w), 0)
+
+    dst   = (uint16_t*)dst1  + offset;
+    prev  = (uint16_t*)prev1 + offset;
+    cur   = (uint16_t*)cur1  + offset;
+    next  = (uint16_t*)next1 + offset;
+    prev2 = (uint16_t*)(parity ? prev : cur);
+    next2 = (uint16_t*)(parity ? cur  : next);
+
+    FILTER(offset, w - 3, 1)
+    offset = CORE_MAX(offset, w - 3);
+    FILTER(offset, w, 0)
+}
+
+void ff_fmdif_yadif_line_interleaved_16bit(void *dst1, void *prev1, void *cur1, void *next1,
+                                           int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint16_t *dst  = dst1;
+    uint16_t *prev = prev1;
+    uint16_t *cur  = cur1;
+    uint16_t *next = next1;
+    int x;
+    uint16_t *prev2 = parity ? prev : cur ;
+    uint16_t *next2 = parity ? cur  : next;
+    mrefs /= 2;
+    prefs /= 2;
+
+    FILTER(0, w, 0)
+}
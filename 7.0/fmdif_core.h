@@ -0,0 +1,149 @@
+/*
+ * Comb detection kernels, field match decision and yadif line kernels of
+ * the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * Based on vf_fieldmatch:
+ * Copyright (c) 2012 Fredrik Mellbin
+ * Copyright (c) 2013 Clément Bœsch
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This part only depends on the C library, so that libfmdif builds it as it
+ * is, outside of FFmpeg.
+ */
+
+#ifndef AVFILTER_FMDIF_CORE_H
+#define AVFILTER_FMDIF_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* field match candidates: current frame weaved with the previous, itself or the next one */
+enum { mP, mC, mN };
+
+/**
+ * Build the comb mask of a plane of width x height samples, step bytes apart:
+ * 0xff where the sample differs by more than cthresh from the lines above and
+ * below and the [1 -3 4 -3 1] vertical filter exceeds 6 * cthresh, 0x00
+ * elsewhere. A negative cthresh marks the whole plane as combed.
+ */
+void ff_fmdif_comb_mask_plane(uint8_t *cmkp, ptrdiff_t cmk_linesize,
+                              const uint8_t *srcp, ptrdiff_t src_linesize,
+                              int width, int height, int step, int cthresh);
+
+/**
+ * Add to the mask line cmkp the comb mask of the line y of the plane srcp,
+ * whose samples are step bytes apart, at the columns x_start + n * x_step only.
+ */
+void ff_fmdif_comb_mask_line(uint8_t *cmkp, const uint8_t *srcp, ptrdiff_t src_linesize, int step,
+                             int y, int height, int x_start, int x_end, int x_step, int cthresh);
+
+/**
+ * Mark as combed the luma mask around the chroma combed in both directions,
+ * for chroma masks of width x height, as fieldmatch does.
+ */
+void ff_fmdif_comb_dilate_chroma(uint8_t *cmkp, ptrdiff_t cmk_linesize,
+                                 const uint8_t *cmkpU, const uint8_t *cmkpV,
+                                 ptrdiff_t cmk_linesizeUV, int width, int height);
+
+/**
+ * Return the number of block counters the block counting needs for a luma mask
+ * of width x height.
+ */
+int ff_fmdif_comb_blocks_size(int width, int height, int blockx, int blocky);
+
+/**
+ * Return the highest number of combed pixels in a blockx x blocky block of the
+ * luma mask, using c_array as the block counters.
+ */
+typedef int (*FMDIFCountBlocksFn)(const uint8_t *cmask, ptrdiff_t cmk_linesize,
+                                  int width, int height, int blockx, int blocky,
+                                  int *c_array);
+
+/**
+ * Return the block counting for blockx x blocky blocks.
+ */
+FMDIFCountBlocksFn ff_fmdif_comb_count_blocks_fn(int blockx, int blocky);
+
+/**
+ * Build the luma comb mask of width x height samples step bytes apart, as
+ * ff_fmdif_comb_mask_plane() does, and return its block count. For a negative
+ * cthresh, the score of a plane combed everywhere is returned and the mask is
+ * left as is.
+ */
+typedef int (*FMDIFScoreLumaFn)(uint8_t *cmask, ptrdiff_t cmk_linesize,
+                                const uint8_t *srcp, ptrdiff_t src_linesize,
+                                int width, int height, int blockx, int blocky,
+                                int cthresh, int *c_array);
+
+/**
+ * Return the luma scoring for blockx x blocky blocks, samples step bytes
+ * apart (1 or 2) and cthresh.
+ */
+FMDIFScoreLumaFn ff_fmdif_comb_score_luma_fn(int blockx, int blocky, int step, int cthresh);
+
+/**
+ * Return the comb score of candidate match, or -1 if it cannot be built. If
+ * *full is 0 the score may only be a lower bound, the luma one, and *full is
+ * set to whether it includes everything. It is asked again for the candidates
+ * already scored, so the scores are cached.
+ */
+typedef int (*FMDIFScoreFn)(void *opaque, int match, int *full);
+
+/**
+ * Decide the match of a field, scoring the candidates on demand. last_match
+ * is the decision of the same field one cycle before, thresh the score from
+ * which a candidate is combed, halved after an unmatched field if halve is
+ * set as fmdif2 does. Lower bound scores less than tol below the threshold
+ * in use are completed, and so are those of both candidates when they are
+ * compared. Return the match, or -1 if no candidate is clean and the field is
+ * to be interpolated.
+ */
+int ff_fmdif_match_field(int last_match, int is_second, int thresh, int halve, int tol,
+                         FMDIFScoreFn score, void *opaque);
+
+/* alignment of the SIMD yadif kernels, which the edge kernels make up for */
+#define FMDIF_YADIF_MAX_ALIGN 8
+
+/*
+ * The C line kernels of yadif, with the arguments of YADIFContext.filter_line
+ * and filter_edges: mode 2 skips the spatial check of the lines two fields
+ * away. ff_fmdif_yadif_line*() interpolate w samples, reading 3 samples to
+ * their left and right, and are given a line without its first 3 samples
+ * and its last FMDIF_YADIF_MAX_ALIGN / bytes per sample + 2 ones, which
+ * ff_fmdif_yadif_edges*() interpolate from the start of the line of w
+ * samples. ff_fmdif_yadif_line_interleaved*() interpolate a whole line
+ * without the edge directed spatial prediction, which would mix the U and V
+ * samples of semi-planar chroma.
+ */
+void ff_fmdif_yadif_line(void *dst, void *prev, void *cur, void *next,
+                         int w, int prefs, int mrefs, int parity, int mode);
+void ff_fmdif_yadif_edges(void *dst, void *prev, void *cur, void *next,
+                          int w, int prefs, int mrefs, int parity, int mode);
+void ff_fmdif_yadif_line_interleaved(void *dst, void *prev, void *cur, void *next,
+                                     int w, int prefs, int mrefs, int parity, int mode);
+void ff_fmdif_yadif_line_16bit(void *dst, void *prev, void *cur, void *next,
+                               int w, int prefs, int mrefs, int parity, int mode);
+void ff_fmdif_yadif_edges_16bit(void *dst, void *prev, void *cur, void *next,
+                                int w, int prefs, int mrefs, int parity, int mode);
+void ff_fmdif_yadif_line_interleaved_16bit(void *dst, void *prev, void *cur, void *next,
+                                           int w, int prefs, int mrefs, int parity, int mode);
+
+#endif /* AVFILTER_FMDIF_CORE_H */
@@ -0,0 +1,551 @@
+/*
+ * Field match decision shared by the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "avfilter.h"
+#include "fmdif_match.h"
+
+const char *const ff_fmdif_match_names[3] = { "p", "c", "n" };
+
+/* the field being decided and its candidates, scored on demand */
+typedef struct MatchField {
+    AVFilterContext *ctx;
+    FMDIFMatchContext *m;
+    AVFilterLink *link;
+    const AVFrame *prev;
+    AVFrame *cur;
+    const AVFrame *next;
+    AVFrame *dst;                   ///< output picture, NULL if only deciding
+    int tff;
+    int is_second;
+    int combs[3];                   ///< scores, -1 if unknown or the weave failed
+    int scored[3];                  ///< combs was already looked up
+    int full[3];                    ///< combs includes the chroma, not only the luma
+    int prev_score;                 ///< measured mC score of prev, -1 if unknown
+    int prev_full;                  ///< prev_score includes the chroma
+    int rep_first, rep_second;      ///< fields of cur repeated from prev
+} MatchField;
+
+/* the current frame is output by reference, so a field pairing kept by both
+ * fields in send_field mode shares one buffer, only the timestamp differs */
+static void copy_output(const MatchField *f, const AVFrame *src)
+{
+    AVFrame *dstpic = f->dst, *ref;
+
+    if (!dstpic)
+        return;
+    if (src->data[0] == f->cur->data[0] && (ref = av_frame_clone(src))) {
+        ref->pts      = dstpic->pts;
+        ref->duration = dstpic->duration;
+        ref->flags    = dstpic->flags;
+        av_frame_unref(dstpic);
+        av_frame_move_ref(dstpic, ref);
+        av_frame_free(&ref);
+        return;
+    }
+    av_frame_copy(dstpic, src);
+}
+
+static AVFrame *weave(const MatchField *f, int match)
+{
+    return ff_fmdif_comb_weave(&f->m->comb, f->link, match, f->tff, f->prev, f->cur, f->next);
+}
+
+/* decision exported by fmdifanalyze, FMDIF_MATCH_UNKNOWN if none */
+static int get_analyzed_match(const AVFrame *frame, int is_second)
+{
+    const AVDictionaryEntry *e;
+    int i;
+
+    e = av_dict_get(frame->metadata, is_second ? "lavfi.fmdif.match.second"
+                                               : "lavfi.fmdif.match.first", NULL, 0);
+    if (!e)
+        return FMDIF_MATCH_UNKNOWN;
+    if (!strcmp(e->value, "none"))
+        return -1;
+    for (i = 0; i < FF_ARRAY_ELEMS(ff_fmdif_match_names); i++)
+        if (!strcmp(e->value, ff_fmdif_match_names[i]))
+            return i;
+    return FMDIF_MATCH_UNKNOWN;
+}
+
+/* decision derived from the classification of idet, FMDIF_MATCH_UNKNOWN if none */
+static int get_hinted_match(FMDIFMatchContext *m, const AVFrame *frame, int is_second)
+{
+    const AVDictionaryEntry *e;
+
+    e = av_dict_get(frame->metadata, "lavfi.idet.multiple.current_frame", NULL, 0);
+    if (!e)
+        e = av_dict_get(frame->metadata, "lavfi.idet.single.current_frame", NULL, 0);
+
+    if (!is_second) {
+        if (e && (!strcmp(e->value, "tff") || !strcmp(e->value, "bff")))
+            m->interlaced_run = FFMIN(m->interlaced_run + 1, m->cycle);
+        else
+            m->interlaced_run = 0;
+    }
+
+    if (!e)
+        return FMDIF_MATCH_UNKNOWN;
+    if (!strcmp(e->value, "progressive"))
+        return mC;
+    /* a whole cycle of interlaced frames cannot be telecined */
+    if (m->interlaced_run >= m->cycle)
+        return -1;
+    return FMDIF_MATCH_UNKNOWN;
+}
+
+static int apply_match(MatchField *f, int match)
+{
+    AVFrame *weaved_frame;
+
+    /* the cached weave is not kept up to date while applying */
+    ff_fmdif_match_reset_cache(f->m);
+
+    if (match < 0 || !f->dst)
+        return match;
+
+    weaved_frame = weave(f, match);
+    if (!weaved_frame) {
+        av_log(f->ctx, AV_LOG_WARNING, "Cannot create weave frame. skipped to match fields\n");
+        return -1;
+    }
+    copy_output(f, weaved_frame);
+    av_frame_free(&weaved_frame);
+    return match;
+}
+
+/* pairing implied by soft pulldown flags, FMDIF_MATCH_UNKNOWN if none */
+static int get_flagged_match(const AVFrame *prev, const AVFrame *cur)
+{
+    /* repeat_first_field is only allowed on progressive pictures */
+    if ((cur->flags & AV_FRAME_FLAG_INTERLACED) && !cur->repeat_pict)
+        return FMDIF_MATCH_UNKNOWN;
+
+    /* a repeated field flips the field order of the following frame */
+    if (prev && prev != cur && prev->repeat_pict &&
+        !(prev->flags & AV_FRAME_FLAG_TOP_FIELD_FIRST) ==
+        !(cur ->flags & AV_FRAME_FLAG_TOP_FIELD_FIRST))
+        return FMDIF_MATCH_UNKNOWN;
+
+    return mC;
+}
+
+static int match_flagged(MatchField *f)
+{
+    FMDIFMatchContext *m = f->m;
+
+    if (get_flagged_match(f->prev, f->cur) != mC)
+        return FMDIF_MATCH_UNKNOWN;
+
+    /* the cached weave is not kept up to date while following flags */
+    ff_fmdif_match_reset_cache(m);
+
+    /* comb scoring is only a sanity check of the flags */
+    if (m->pulldown == FMDIF_PULLDOWN_CHECK) {
+        f->combs[mC] = m->cur_combed_score = ff_fmdif_comb_score(&m->comb, f->cur, 0, 1);
+        m->cur_combed_estimated = 0;
+        m->cur_combed_full = 1;
+        if (f->combs[mC] >= ff_fmdif_comb_thresh(&m->comb)) {
+            av_log(f->ctx, AV_LOG_DEBUG, "Combed frame flagged as progressive: %d\n", f->combs[mC]);
+            return FMDIF_MATCH_UNKNOWN;
+        }
+    }
+    av_log(f->ctx, AV_LOG_DEBUG, "PULLDOWN(%d): %3d:match=%d\n", f->is_second, f->combs[mC], mC);
+
+    copy_output(f, f->cur);
+    return mC;
+}
+
+/* mean difference of a field of two frames, computed on every FMDIF_FIELD_DIFF_STEP-th line */
+static double calc_field_diff(const FMDIFMatchContext *m, const AVFrame *a, const AVFrame *b, int field)
+{
+    const int step = FMDIF_FIELD_DIFF_STEP * 2;
+    const int nb_lines = (a->height - field + step - 1) / step;
+    uint64_t sad = 0;
+
+    m->sad(a->data[0] + field * a->linesize[0], a->linesize[0] * step,
+           b->data[0] + field * b->linesize[0], b->linesize[0] * step,
+           a->width, nb_lines, &sad);
+    return (double)sad / (a->width * nb_lines);
+}
+
+static int is_repeated_field(const FMDIFMatchContext *m, const AVFrame *a, const AVFrame *b, int field)
+{
+    if (!m->prescreen || !a || !b || a == b)
+        return 0;
+    return calc_field_diff(m, a, b, field) <= m->prescreen * (1 << (m->depth - 8));
+}
+
+static int copy_match_frame(MatchField *f, int match)
+{
+    FMDIFMatchContext *m = f->m;
+
+    if (!f->dst)
+        return 0;
+    if (match == mC) {
+        copy_output(f, f->cur);
+        return 0;
+    }
+    /* only the score may have been estimated by the pre-screen */
+    if (!m->weaved_frame) {
+        m->weaved_frame = weave(f, match);
+        if (!m->weaved_frame)
+            return AVERROR(ENOMEM);
+    }
+    av_frame_copy(f->dst, m->weaved_frame);
+    return 0;
+}
+
+/* reuse the decision of the same field of the previous frame on a still scene */
+static int match_still(MatchField *f)
+{
+    FMDIFMatchContext *m = f->m;
+    const int is_second = f->is_second;
+    /* both candidates of a field are made of these two frames */
+    const AVFrame *a = is_second ? f->cur  : f->prev;
+    const AVFrame *b = is_second ? f->next : f->cur;
+    const double thresh = m->stillthresh * (1 << (m->depth - 8));
+    int match = m->prev_match[is_second];
+
+    /* do not let a slow change drift for more than a cycle */
+    if (match == FMDIF_MATCH_UNKNOWN || m->still_count[is_second] >= m->cycle ||
+        calc_field_diff(m, a, b, 0) > thresh || calc_field_diff(m, a, b, 1) > thresh) {
+        m->still_count[is_second] = 0;
+        return FMDIF_MATCH_UNKNOWN;
+    }
+    m->still_count[is_second]++;
+
+    /* the scores are those of prev on a still first field */
+    if (m->weaved_frame)
+        av_frame_free(&m->weaved_frame);
+    m->wf_combed_score = -1;
+    m->cur_combed_estimated = 1;
+
+    av_log(f->ctx, AV_LOG_DEBUG, "STILL(%d): match=%d\n", is_second, match);
+
+    /* all candidates are the same picture */
+    if (match >= 0)
+        copy_output(f, f->cur);
+    return match;
+}
+
+static int weave_and_score(MatchField *f, int match, int full)
+{
+    FMDIFMatchContext *m = f->m;
+
+    if (m->weaved_frame)
+        av_frame_free(&m->weaved_frame);
+    m->weaved_frame = weave(f, match);
+    return m->weaved_frame ? ff_fmdif_comb_score(&m->comb, m->weaved_frame, 0, full) : -1;
+}
+
+/* whether a score measured now for a request of full includes the chroma */
+static int is_full(const FMDIFMatchContext *m, int full)
+{
+    return full || !ff_fmdif_comb_chromatol(&m->comb);
+}
+
+/*
+ * A field repeated in a neighbouring frame makes a weave identical to one
+ * whose score is already known, which is then reused instead of building and
+ * scoring it. Estimates are only made from measured scores. A score is only
+ * reused for a request of full if it includes the chroma, see
+ * ff_fmdif_comb_score().
+ */
+static int get_score(MatchField *f, int match, int full);
+
+static int score_cur(MatchField *f, int full)
+{
+    FMDIFMatchContext *m = f->m;
+    int both;
+
+    /* kept from the first field, or from prev on a still one */
+    if (m->cur_combed_score >= 0 && (m->cur_combed_full || !full)) {
+        f->full[mC] = m->cur_combed_full;
+        return m->cur_combed_score;
+    }
+
+    m->cur_combed_estimated = 1;
+    if (!f->is_second && f->rep_first && f->rep_second && f->prev_score >= 0 &&
+        (f->prev_full || !full)) {
+        /* static scene: mC is prev */
+        f->full[mC] = m->cur_combed_full = f->prev_full;
+        return m->cur_combed_score = f->prev_score;
+    } else if (!f->is_second && f->rep_second && m->wf_combed_score >= 0 && !m->wf_combed_estimated &&
+               (m->wf_combed_full || !full)) {
+        /* prev's second field repeats cur's one: mC is mP */
+        f->full[mC] = m->cur_combed_full = m->wf_combed_full;
+        return m->cur_combed_score = m->wf_combed_score;
+    }
+    m->cur_combed_estimated = 0;
+    f->full[mC] = m->cur_combed_full = is_full(m, full);
+
+    /* mP cannot be estimated from mC or prev either: score both at once */
+    both = m->parallel && !f->is_second && m->wf_combed_score < 0 &&
+           !f->rep_second && !(f->rep_first && f->prev_score >= 0);
+    if (both) {
+        if (m->weaved_frame)
+            av_frame_free(&m->weaved_frame);
+        m->weaved_frame = weave(f, mP);
+    }
+    if (both && m->weaved_frame) {
+        ff_fmdif_comb_score2(f->ctx, &m->comb, f->cur, m->weaved_frame, full,
+                             &m->cur_combed_score, &f->combs[mP]);
+        f->scored[mP] = 1;
+        f->full[mP] = m->cur_combed_full;
+    } else {
+        m->cur_combed_score = ff_fmdif_comb_score(&m->comb, f->cur, 0, full);
+    }
+    return m->cur_combed_score;
+}
+
+static int score_prev_weave(MatchField *f, int full)
+{
+    FMDIFMatchContext *m = f->m;
+
+    /* the mN weave of the previous frame, if its second field needed it */
+    if (m->wf_combed_score >= 0 && (m->wf_combed_full || !full)) {
+        f->full[mP] = m->wf_combed_full;
+        return m->wf_combed_score;
+    }
+    if (f->rep_second && get_score(f, mC, full) >= 0 && !m->cur_combed_estimated) {
+        f->full[mP] = f->full[mC];
+        return f->combs[mC];
+    }
+    if (f->rep_first && f->prev_score >= 0 && (f->prev_full || !full)) {
+        /* cur's first field repeats prev's one: mP is prev */
+        f->full[mP] = f->prev_full;
+        return f->prev_score;
+    }
+    f->full[mP] = is_full(m, full);
+    return weave_and_score(f, mP, full);
+}
+
+static int score_next_weave(MatchField *f, int full)
+{
+    FMDIFMatchContext *m = f->m;
+
+    /* no next frame to weave with */
+    if (m->lowdelay)
+        return -1;
+
+    /* kept for the first field of the next frame, where it is mP */
+    m->wf_combed_estimated = 0;
+    if (is_repeated_field(m, f->cur, f->next, !f->tff) &&
+        get_score(f, mC, full) >= 0 && !m->cur_combed_estimated) {
+        /* next's first field repeats cur's one: mN is mC */
+        m->wf_combed_estimated = 1;
+        f->full[mN] = m->wf_combed_full = f->full[mC];
+        return m->wf_combed_score = f->combs[mC];
+    }
+    f->full[mN] = m->wf_combed_full = is_full(m, full);
+    return m->wf_combed_score = weave_and_score(f, mN, full);
+}
+
+static int get_score(MatchField *f, int match, int full)
+{
+    if (!f->scored[match] || (full && !f->full[match])) {
+        f->scored[match] = 1;
+        f->combs[match] = match == mC ? score_cur(f, full) :
+                          match == mP ? score_prev_weave(f, full) :
+                                        score_next_weave(f, full);
+    }
+    return f->combs[match];
+}
+
+static int score_field(void *opaque, int match, int *full)
+{
+    MatchField *f = opaque;
+    const int score = get_score(f, match, *full);
+
+    *full = f->full[match];
+    return score;
+}
+
+static int match_fields(MatchField *f)
+{
+    FMDIFMatchContext *m = f->m;
+    const int is_second = f->is_second;
+    const int *combs = f->combs;
+    const int pn = is_second ? mN : mP;
+    int match;
+
+    /*
+     * Candidates are only scored when the decision below needs them, which
+     * typically is one per field. The scores kept across fields (mC for the
+     * second field and the pre-screen of the next frame, mN for the mP of the
+     * next frame) are then only there when a field asked for them.
+     */
+    if (is_second) {
+        if (m->weaved_frame)
+            av_frame_free(&m->weaved_frame);
+        m->wf_combed_score = -1;
+        m->wf_combed_estimated = 0;
+    } else {
+        f->prev_score = m->cur_combed_estimated ? -1 : m->cur_combed_score;
+        f->prev_full  = m->cur_combed_full;
+        f->rep_first  = is_repeated_field(m, f->prev, f->cur, !f->tff);
+        f->rep_second = is_repeated_field(m, f->prev, f->cur,  f->tff);
+        m->cur_combed_score = -1;
+        m->cur_combed_estimated = 0;
+    }
+
+    match = ff_fmdif_match_field(m->last_match[m->fid + (m->cycle * is_second)], is_second,
+                                 ff_fmdif_comb_thresh(&m->comb), m->halve,
+                                 ff_fmdif_comb_chromatol(&m->comb), score_field, f);
+    /* mC is always there, so only the weave can be missing */
+    if (match < 0 && f->scored[pn] && combs[pn] < 0 && !(m->lowdelay && is_second))
+        av_log(f->ctx, AV_LOG_WARNING, "Cannot create weave frame. skipped to match fields\n");
+    if (match >= 0 && copy_match_frame(f, match) < 0) {
+        av_log(f->ctx, AV_LOG_WARNING, "Cannot create weave frame. skipped to match fields\n");
+        match = -1;
+    }
+    av_log(f->ctx, AV_LOG_DEBUG, "COMBS(%d): %3d %3d %3d:match=%d\n", is_second, combs[0], combs[1], combs[2], match);
+
+    /* free the weaved frame if needed */
+    if (!is_second) {
+        if (m->weaved_frame)
+            av_frame_free(&m->weaved_frame);
+        m->wf_combed_score = -1;
+    }
+
+    return match;
+}
+
+int ff_fmdif_match_frame(AVFilterContext *ctx, FMDIFMatchContext *m, AVFilterLink *link,
+                         const AVFrame *prev, AVFrame *cur, const AVFrame *next,
+                         AVFrame *dst, int tff, int is_second)
+{
+    MatchField f = {
+        .ctx = ctx, .m = m, .link = link, .prev = prev, .cur = cur, .next = next,
+        .dst = dst, .tff = tff, .is_second = is_second, .combs = { -1, -1, -1 },
+    };
+    int match;
+
+    /* follow the decision of fmdifanalyze or idet if any */
+    match = FMDIF_MATCH_UNKNOWN;
+    if (m->apply)
+        match = get_analyzed_match(cur, is_second);
+    if (match == FMDIF_MATCH_UNKNOWN && m->hints)
+        match = get_hinted_match(m, cur, is_second);
+    if (match != FMDIF_MATCH_UNKNOWN)
+        match = apply_match(&f, match);
+
+    /* then try the shortcuts before scoring candidates */
+    if (match == FMDIF_MATCH_UNKNOWN && m->pulldown)
+        match = match_flagged(&f);
+    if (match == FMDIF_MATCH_UNKNOWN && m->stillthresh > 0)
+        match = match_still(&f);
+    if (match == FMDIF_MATCH_UNKNOWN)
+        match = match_fields(&f);
+
+    memcpy(m->combs, f.combs, sizeof(m->combs));
+    m->prev_match[is_second] = match;
+
+    /* keep the last match value in cycle */
+    m->last_match[m->fid + (m->cycle * is_second)] = match;
+    if (!is_second)
+        if (++m->fid >= m->cycle)
+            m->fid = 0;
+
+    return match;
+}
+
+void ff_fmdif_match_reset_cache(FMDIFMatchContext *m)
+{
+    if (m->weaved_frame)
+        av_frame_free(&m->weaved_frame);
+    m->wf_combed_score  = -1;
+    m->cur_combed_score = -1;
+}
+
+int ff_fmdif_match_reset_rhythm(FMDIFMatchContext *m)
+{
+    int i, *last_match = av_malloc_array(m->cycle * 2, sizeof(*last_match));
+
+    if (!last_match)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < m->cycle * 2; i++)
+        last_match[i] = -1;
+    av_freep(&m->last_match);
+    m->last_match = last_match;
+    m->fid        = 0;
+    m->prev_match[0] = m->prev_match[1] = FMDIF_MATCH_UNKNOWN;
+    return 0;
+}
+
+int ff_fmdif_match_config(FMDIFMatchContext *m, const AVFilterLink *link)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
+    int ret;
+
+    m->comb.nb_jobs = m->parallel ? FMDIF_COMB_MAX_JOBS : 1;
+    if ((ret = ff_fmdif_comb_config(&m->comb, link)) < 0)
+        return ret;
+
+    m->depth = desc->comp[0].depth + desc->comp[0].shift;
+    m->sad   = ff_scene_sad_get_fn(m->depth > 8 ? 16 : 8);
+    if (!m->sad)
+        return AVERROR(EINVAL);
+
+    ff_fmdif_match_reset_cache(m);
+    return 0;
+}
+
+int ff_fmdif_match_update(FMDIFMatchContext *m, int w, int h, int blockx, int blocky, int cycle)
+{
+    int ret;
+
+    /* the comb kernels follow blockx, blocky and cthresh */
+    if ((ret = ff_fmdif_comb_alloc_blocks(&m->comb, w, h)) < 0) {
+        m->comb.blockx = blockx;
+        m->comb.blocky = blocky;
+        return ret;
+    }
+    if (m->cycle != cycle && (ret = ff_fmdif_match_reset_rhythm(m)) < 0) {
+        m->cycle = cycle;
+        return ret;
+    }
+
+    /* the cached scores were computed with the previous settings */
+    ff_fmdif_match_reset_cache(m);
+    return 0;
+}
+
+void ff_fmdif_match_detect_borders(FMDIFMatchContext *m, const AVFrame *frame)
+{
+    /* the cached scores were computed on the previous window */
+    if (ff_fmdif_comb_detect_borders(&m->comb, frame))
+        ff_fmdif_match_reset_cache(m);
+}
+
+void ff_fmdif_match_uninit(FMDIFMatchContext *m)
+{
+    if (m->weaved_frame)
+        av_frame_free(&m->weaved_frame);
+    av_freep(&m->last_match);
+    ff_fmdif_comb_uninit(&m->comb);
+}
@@ -0,0 +1,120 @@
+/*
+ * Field match decision shared by the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FMDIF_MATCH_H
+#define AVFILTER_FMDIF_MATCH_H
+
+#include "libavutil/frame.h"
+#include "avfilter.h"
+#include "fmdif_comb.h"
+#include "scene_sad.h"
+
+/* match of a field not decided yet */
+#define FMDIF_MATCH_UNKNOWN -2
+
+/* field lines subsampling of field differences */
+#define FMDIF_FIELD_DIFF_STEP 4
+
+enum FMDIFPulldown {
+    FMDIF_PULLDOWN_OFF,
+    FMDIF_PULLDOWN_CHECK,
+    FMDIF_PULLDOWN_TRUST,
+};
+
+/* names of the matches in the metadata exported by fmdifanalyze */
+extern const char *const ff_fmdif_match_names[3];
+
+typedef struct FMDIFMatchContext {
+    FMDIFCombContext comb;
+
+    /* options, set by the filter */
+    int cycle;
+    int apply;
+    int hints;
+    int pulldown;                   ///< FMDIFPulldown
+    double prescreen;
+    double stillthresh;
+    int parallel;
+    int halve;                      ///< halve the threshold after an unmatched field
+    int lowdelay;                   ///< there is no next frame, mN is never a candidate
+
+    /* rhythm */
+    int *last_match;                ///< last values of match
+    int fid;                        ///< current frame id
+    int interlaced_run;             ///< number of successive frames idet marked as interlaced
+    int prev_match[2];              ///< match of each field of the previous frame
+    int still_count[2];             ///< number of successive reuses of prev_match
+    int combs[3];                   ///< scores of the last field decided, -1 if not scored
+
+    /* scores kept across fields and frames */
+    int cur_combed_score;           ///< comb score of current frame, -1 if unknown
+    int cur_combed_estimated;       ///< cur_combed_score was reused by the pre-screen
+    int cur_combed_full;            ///< cur_combed_score includes the chroma
+    AVFrame *weaved_frame;          ///< weaved frame with prev/next
+    int wf_combed_score;            ///< comb score of weaved frame, -1 if unknown
+    int wf_combed_estimated;        ///< wf_combed_score was reused by the pre-screen
+    int wf_combed_full;             ///< wf_combed_score includes the chroma
+
+    int depth;                      ///< bit depth of luma, including the shift of P010
+    ff_scene_sad_fn sad;            ///< field difference of the pre-screen and the still check
+} FMDIFMatchContext;
+
+/**
+ * Set up for the frames of link, on the first configuration or a change of
+ * size. The rhythm is kept, the cached scores are dropped.
+ */
+int ff_fmdif_match_config(FMDIFMatchContext *m, const AVFilterLink *link);
+
+/**
+ * Restart the rhythm from scratch, for cycle frames.
+ */
+int ff_fmdif_match_reset_rhythm(FMDIFMatchContext *m);
+
+/**
+ * Drop the scores kept across fields, once they do not apply anymore.
+ */
+void ff_fmdif_match_reset_cache(FMDIFMatchContext *m);
+
+/**
+ * Apply a change of the runtime options of a link of size w x h. blockx,
+ * blocky and cycle are the previous values, restored on failure.
+ */
+int ff_fmdif_match_update(FMDIFMatchContext *m, int w, int h, int blockx, int blocky, int cycle);
+
+/**
+ * Feed frame to the border detection, dropping the cached scores if the
+ * analysis window moved.
+ */
+void ff_fmdif_match_detect_borders(FMDIFMatchContext *m, const AVFrame *frame);
+
+void ff_fmdif_match_uninit(FMDIFMatchContext *m);
+
+/**
+ * Decide the match of a field of cur, prev and next being its neighbours in
+ * the frames of link, and move the rhythm on. If dst is not NULL, the matched
+ * picture is output to it. Return the match, or -1 if the field is to be
+ * interpolated.
+ */
+int ff_fmdif_match_frame(AVFilterContext *ctx, FMDIFMatchContext *m, AVFilterLink *link,
+                         const AVFrame *prev, AVFrame *cur, const AVFrame *next,
+                         AVFrame *dst, int tff, int is_second);
+
+#endif /* AVFILTER_FMDIF_MATCH_H */
@@ -0,0 +1,102 @@
+/*
+ * yadif interpolation shared by the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * Based on vf_yadif:
+ * Copyright (C) 2006-2011 Michael Niedermayer <michaelni@gmx.at>
+ *               2010      James Darnley <james.darnley@gmail.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/pixdesc.h"
+#include "fmdif_core.h"
+#include "fmdif_yadif.h"
+#include "yadif.h"
+
+void ff_fmdif_yadif_slice(const YADIFContext *s, const FMDIFThreadData *td,
+                          int interleaved, int jobnr, int nb_jobs)
+{
+    int refs = s->cur->linesize[td->plane];
+    int df = (s->csp->comp[td->plane].depth + 7) / 8;
+    int pix_3 = 3 * df;
+    int slice_start = (td->h *  jobnr   ) / nb_jobs;
+    int slice_end   = (td->h * (jobnr+1)) / nb_jobs;
+    int y;
+    int edge = 3 + FMDIF_YADIF_MAX_ALIGN / df - 1;
+    /* the kernels only know the yadif modes, send_film interpolates as send_frame */
+    const int frame_mode = s->mode & 3;
+    void (*filter_uv)(void *dst, void *prev, void *cur, void *next,
+                      int w, int prefs, int mrefs, int parity, int mode) =
+        df > 1 ? ff_fmdif_yadif_line_interleaved_16bit : ff_fmdif_yadif_line_interleaved;
+
+    /* filtering reads 3 pixels to the left/right; to avoid invalid reads,
+     * we need to call the c variant which avoids this for border pixels
+     */
+    for (y = slice_start; y < slice_end; y++) {
+        if ((y ^ td->parity) & 1) {
+            uint8_t *prev = &s->prev->data[td->plane][y * refs];
+            uint8_t *cur  = &s->cur ->data[td->plane][y * refs];
+            uint8_t *next = &s->next->data[td->plane][y * refs];
+            uint8_t *dst  = &td->frame->data[td->plane][y * td->frame->linesize[td->plane]];
+            int     mode  = y == 1 || y + 2 == td->h ? 2 : frame_mode;
+            if (interleaved) {
+                filter_uv(dst, prev, cur, next, td->w,
+                          y + 1 < td->h ? refs : -refs,
+                          y ? -refs : refs,
+                          td->parity ^ td->tff, mode);
+                continue;
+            }
+            s->filter_line(dst + pix_3, prev + pix_3, cur + pix_3,
+                           next + pix_3, td->w - edge,
+                           y + 1 < td->h ? refs : -refs,
+                           y ? -refs : refs,
+                           td->parity ^ td->tff, mode);
+            s->filter_edges(dst, prev, cur, next, td->w,
+                            y + 1 < td->h ? refs : -refs,
+                            y ? -refs : refs,
+                            td->parity ^ td->tff, mode);
+        } else {
+            memcpy(&td->frame->data[td->plane][y * td->frame->linesize[td->plane]],
+                   &s->cur->data[td->plane][y * refs], td->w * df);
+        }
+    }
+}
+
+void ff_fmdif_yadif_init(YADIFContext *s)
+{
+    if (s->csp->comp[0].depth > 8) {
+        s->filter_line  = ff_fmdif_yadif_line_16bit;
+        s->filter_edges = ff_fmdif_yadif_edges_16bit;
+    } else {
+        s->filter_line  = ff_fmdif_yadif_line;
+        s->filter_edges = ff_fmdif_yadif_edges;
+    }
+
+#if ARCH_X86
+    {
+        /* the SIMD kernels go by depth, but shifted samples such as P010
+         * use the whole 16 bits */
+        const AVPixFmtDescriptor *csp = s->csp;
+        if (csp->comp[0].shift)
+            s->csp = av_pix_fmt_desc_get(AV_PIX_FMT_P016);
+        ff_yadif_init_x86(s);
+        s->csp = csp;
+    }
+#endif
+}
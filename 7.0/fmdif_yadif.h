@@ -0,0 +1,50 @@
+/*
+ * yadif interpolation shared by the fmdif filters
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FMDIF_YADIF_H
+#define AVFILTER_FMDIF_YADIF_H
+
+#include "libavutil/frame.h"
+#include "yadif.h"
+
+/* a plane of the field being interpolated, the argument of the slice jobs */
+typedef struct FMDIFThreadData {
+    AVFrame *frame;
+    int plane;
+    int w, h;
+    int parity;
+    int tff;
+} FMDIFThreadData;
+
+/**
+ * Set the line kernels of s for the format s->csp, the SIMD ones if any.
+ */
+void ff_fmdif_yadif_init(YADIFContext *s);
+
+/**
+ * Interpolate the lines of the slice jobnr of td->plane missing from the
+ * field, and copy the others from the current frame. interleaved is set for
+ * semi-planar chroma, whose U and V samples are not mixed.
+ */
+void ff_fmdif_yadif_slice(const YADIFContext *s, const FMDIFThreadData *td,
+                          int interleaved, int jobnr, int nb_jobs);
+
+#endif /* AVFILTER_FMDIF_YADIF_H */
@@ -0,0 +1,202 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check the comb kernels of fmdif_core.c, which are branchless, fused and
+ * specialized by block size, against a plain version of the comb detection
+ * of vf_fieldmatch. Like fmdif_core.c, this only uses the C library.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavfilter/fmdif_core.h"
+
+#define MAX_W 160
+#define MAX_H 96
+#define LINESIZE (MAX_W * 2 + 32)
+#define ARRAY_ELEMS(a) (int)(sizeof(a) / sizeof((a)[0]))
+
+static const int sizes[][2] = { { 160, 96 }, { 77, 45 } };
+static const int blocks[][2] = { { 16, 16 }, { 16, 32 }, { 32, 32 }, { 8, 8 }, { 4, 64 } };
+static const int cthreshs[] = { 9, 20, -1 };
+
+static unsigned seed = 1;
+
+static int rnd(int n)
+{
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 16) % n;
+}
+
+/* a noisy gradient with a few combed rectangles, samples step bytes apart */
+static void fill_picture(uint8_t *src, int w, int h, int step)
+{
+    int x, y, i;
+
+    for (y = 0; y < h; y++)
+        for (x = 0; x < w; x++) {
+            src[y * LINESIZE + x * step] = (x + y) & 0x7f;
+            src[y * LINESIZE + x * step] += rnd(8);
+            if (step > 1)
+                src[y * LINESIZE + x * step - 1] = rnd(256);
+        }
+    for (i = 0; i < 6; i++) {
+        const int x0 = rnd(w), y0 = rnd(h);
+        const int x1 = x0 + 1 + rnd(w / 3), y1 = y0 + 1 + rnd(h / 3);
+        const int amp = 10 + rnd(40);
+
+        for (y = y0 | 1; y < y1 && y < h; y += 2)
+            for (x = x0; x < x1 && x < w; x++)
+                src[y * LINESIZE + x * step] += amp;
+    }
+}
+
+/* the row d away from y, taken on the other side of y out of the picture */
+static int mirror(int y, int d, int h)
+{
+    return y + d < 0 || y + d >= h ? y - d : y + d;
+}
+
+static void ref_mask(uint8_t *cmask, const uint8_t *src, int w, int h, int step, int cthresh)
+{
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        const uint8_t *up2 = src + mirror(y, -2, h) * LINESIZE;
+        const uint8_t *up1 = src + mirror(y, -1, h) * LINESIZE;
+        const uint8_t *cur = src + y * LINESIZE;
+        const uint8_t *dn1 = src + mirror(y,  1, h) * LINESIZE;
+        const uint8_t *dn2 = src + mirror(y,  2, h) * LINESIZE;
+
+        for (x = 0; x < w; x++) {
+            const int p = cur[x * step];
+            const int a = up1[x * step], b = dn1[x * step];
+
+            if (cthresh < 0 ||
+                (abs(p - a) > cthresh && abs(p - b) > cthresh &&
+                 abs(4 * p - 3 * (a + b) + up2[x * step] + dn2[x * step]) > cthresh * 6))
+                cmask[y * LINESIZE + x] = 0xff;
+            else
+                cmask[y * LINESIZE + x] = 0;
+        }
+    }
+}
+
+/* the most pixels combed with the ones above and below in a block of any of
+ * the four grids offset by half a block, the first and last rows left out */
+static int ref_count(const uint8_t *cmask, int w, int h, int blockx, int blocky)
+{
+    int grid, x0, y0, x, y, best = 0;
+
+    for (grid = 0; grid < 4; grid++) {
+        for (y0 = grid & 2 ? -blocky / 2 : 0; y0 < h; y0 += blocky) {
+            for (x0 = grid & 1 ? -blockx / 2 : 0; x0 < w; x0 += blockx) {
+                int count = 0;
+
+                for (y = y0 > 1 ? y0 : 1; y < y0 + blocky && y < h - 1; y++)
+                    for (x = x0 > 0 ? x0 : 0; x < x0 + blockx && x < w; x++)
+                        count += cmask[(y - 1) * LINESIZE + x] == 0xff &&
+                                 cmask[ y      * LINESIZE + x] == 0xff &&
+                                 cmask[(y + 1) * LINESIZE + x] == 0xff;
+                if (count > best)
+                    best = count;
+            }
+        }
+    }
+    return best;
+}
+
+static int diff_mask(const uint8_t *a, const uint8_t *b, int w, int h)
+{
+    int y;
+
+    for (y = 0; y < h; y++)
+        if (memcmp(a + y * LINESIZE, b + y * LINESIZE, w))
+            return 1;
+    return 0;
+}
+
+int main(void)
+{
+    static uint8_t src[MAX_H * LINESIZE];
+    static uint8_t ref[MAX_H * LINESIZE], cmask[MAX_H * LINESIZE];
+    int *c_array = malloc(ff_fmdif_comb_blocks_size(MAX_W, MAX_H, 4, 4) * sizeof(*c_array));
+    int i, j, k, step, x, y, ret = 0;
+
+    if (!c_array)
+        return 1;
+
+    for (i = 0; i < ARRAY_ELEMS(sizes); i++) {
+        const int w = sizes[i][0], h = sizes[i][1];
+
+        for (step = 1; step <= 2; step++) {
+            /* the luma of 16-bit samples is scored on their high byte */
+            const uint8_t *srcp = src + step - 1;
+
+            fill_picture(src + step - 1, w, h, step);
+            for (j = 0; j < ARRAY_ELEMS(cthreshs); j++) {
+                const int cthresh = cthreshs[j];
+
+                ref_mask(ref, srcp, w, h, step, cthresh);
+                ff_fmdif_comb_mask_plane(cmask, LINESIZE, srcp, LINESIZE, w, h, step, cthresh);
+                if (diff_mask(cmask, ref, w, h)) {
+                    printf("%dx%d step %d cthresh %d: mask mismatch\n", w, h, step, cthresh);
+                    ret = 1;
+                }
+                if (cthresh >= 0) {
+                    memset(cmask, 0, sizeof(cmask));
+                    for (y = 0; y < h; y++)
+                        for (x = 0; x < 2; x++)
+                            ff_fmdif_comb_mask_line(cmask + y * LINESIZE, srcp, LINESIZE, step,
+                                                    y, h, x, w, 2, cthresh);
+                    if (diff_mask(cmask, ref, w, h)) {
+                        printf("%dx%d step %d cthresh %d: mask line mismatch\n", w, h, step, cthresh);
+                        ret = 1;
+                    }
+                }
+
+                printf("%dx%d step %d cthresh %d:", w, h, step, cthresh);
+                for (k = 0; k < ARRAY_ELEMS(blocks); k++) {
+                    const int blockx = blocks[k][0], blocky = blocks[k][1];
+                    const int score = ref_count(ref, w, h, blockx, blocky);
+                    int count, luma;
+
+                    count = ff_fmdif_comb_count_blocks_fn(blockx, blocky)(ref, LINESIZE, w, h,
+                                                                          blockx, blocky, c_array);
+                    memset(cmask, 0, sizeof(cmask));
+                    luma = ff_fmdif_comb_score_luma_fn(blockx, blocky, step, cthresh)(cmask, LINESIZE,
+                                                                                   srcp, LINESIZE, w, h,
+                                                                                   blockx, blocky,
+                                                                                   cthresh, c_array);
+                    printf(" %dx%d %d", blockx, blocky, score);
+                    if (count != score || luma != score ||
+                        (cthresh >= 0 && diff_mask(cmask, ref, w, h))) {
+                        printf(" (count %d, luma %d)", count, luma);
+                        ret = 1;
+                    }
+                }
+                printf("\n");
+            }
+        }
+    }
+
+    free(c_array);
+    return ret;
+}
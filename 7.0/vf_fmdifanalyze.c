@@ -0,0 +1,394 @@
+/*
+ * Field Match Analyzing Filter
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * Based on vf_fieldmatch:
+ * Copyright (c) 2012 Fredrik Mellbin
+ * Copyright (c) 2013 Clément Bœsch
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Field match analyzer: runs the field matching decision of fmdif/fmdif2
+ * and exports it as frame metadata without touching the pixels, so that
+ * fmdif/fmdif2 with apply=1 can follow it. The decision can be computed on
+ * a cheaper proxy stream given on a second input.
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "avfilter.h"
+#include "filters.h"
+#include "fmdif_match.h"
+#include "video.h"
+#include "yadif.h"
+
+#define INPUT_MAIN     0
+#define INPUT_PROXY    1
+
+typedef struct FMDIFAnalyzeContext {
+    const AVClass *class;
+    AVFrame *prev, *cur, *next;     ///< frames to analyze
+    AVFrame *main_next;             ///< main frame paired with next
+    AVFrame *pending[2];            ///< main/proxy frames waiting for a pair
+    int eof;
+
+    FMDIFMatchContext match;
+
+    /* options */
+    int parity;
+    int deint;
+    int proxy;
+} FMDIFAnalyzeContext;
+
+/* ================ field match ================ */
+
+static void export_match(AVFrame *out, int is_second, int match, const int *combs)
+{
+    char buf[64];
+    const char *key = is_second ? "lavfi.fmdif.match.second" : "lavfi.fmdif.match.first";
+
+    av_dict_set(&out->metadata, key, match >= 0 ? ff_fmdif_match_names[match] : "none", 0);
+    snprintf(buf, sizeof(buf), "%d %d %d", combs[mP], combs[mC], combs[mN]);
+    key = is_second ? "lavfi.fmdif.combs.second" : "lavfi.fmdif.combs.first";
+    av_dict_set(&out->metadata, key, buf, 0);
+}
+
+/* same decision as fmdif2's, done for both fields at once */
+static void analyze(AVFilterContext *ctx, AVFrame *out)
+{
+    FMDIFAnalyzeContext *fm = ctx->priv;
+    AVFilterLink *link = ctx->inputs[fm->proxy ? INPUT_PROXY : INPUT_MAIN];
+    const AVFrame *prv = fm->prev ? fm->prev : fm->cur;
+    AVFrame *cur = fm->cur;
+    int is_second, tff;
+
+    if (fm->parity == YADIF_PARITY_AUTO)
+        tff = (cur->flags & AV_FRAME_FLAG_INTERLACED) ?
+              !!(cur->flags & AV_FRAME_FLAG_TOP_FIELD_FIRST) : 1;
+    else
+        tff = fm->parity ^ 1;
+
+    for (is_second = 0; is_second < 2; is_second++) {
+        const int match = ff_fmdif_match_frame(ctx, &fm->match, link, prv, cur, fm->next,
+                                               NULL, tff, is_second);
+
+        export_match(out, is_second, match, fm->match.combs);
+    }
+}
+
+static int push_frame(AVFilterContext *ctx, AVFrame *in, AVFrame *proxy)
+{
+    FMDIFAnalyzeContext *fm = ctx->priv;
+    AVFrame *out;
+
+    if (!proxy) {
+        proxy = av_frame_clone(in);
+        if (!proxy) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    av_frame_free(&fm->prev);
+    fm->prev = fm->cur;
+    fm->cur  = fm->next;
+    fm->next = proxy;
+    ff_fmdif_match_detect_borders(&fm->match, proxy);
+    out = fm->main_next;
+    fm->main_next = in;
+
+    /* wait for the lookahead frame */
+    if (!fm->cur)
+        return 0;
+
+    if (fm->deint && !(fm->cur->flags & AV_FRAME_FLAG_INTERLACED)) {
+        /* progressive frame breaks the mN/mP weave chain */
+        ff_fmdif_match_reset_cache(&fm->match);
+        av_frame_free(&fm->prev);
+    } else {
+        analyze(ctx, out);
+    }
+
+    return ff_filter_frame(ctx->outputs[0], out);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    FMDIFAnalyzeContext *fm = ctx->priv;
+    const int w = inlink->w;
+    const int h = inlink->h;
+
+    if (w < 3 || h < 3) {
+        av_log(ctx, AV_LOG_ERROR, "Video of less than 3 columns or lines is not supported\n");
+        return AVERROR(EINVAL);
+    }
+
+    return ff_fmdif_match_config(&fm->match, inlink);
+}
+
+/* analyze the frames of the previous size as at EOF, then restart */
+static int reconfigure(AVFilterContext *ctx, const AVFrame *frame)
+{
+    FMDIFAnalyzeContext *fm = ctx->priv;
+    AVFilterLink *link = ctx->inputs[fm->proxy ? INPUT_PROXY : INPUT_MAIN];
+    AVFrame *in, *proxy;
+    int ret;
+
+    if (frame->format != link->format) {
+        av_log(ctx, AV_LOG_ERROR, "Changing the pixel format from %s to %s is not supported\n",
+               av_get_pix_fmt_name(link->format), av_get_pix_fmt_name(frame->format));
+        return AVERROR(EINVAL);
+    }
+    av_log(ctx, AV_LOG_VERBOSE, "Input changed from %dx%d to %dx%d\n",
+           link->w, link->h, frame->width, frame->height);
+
+    in    = av_frame_clone(fm->main_next);
+    proxy = av_frame_clone(fm->next);
+    if (!in || !proxy) {
+        av_frame_free(&in);
+        av_frame_free(&proxy);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = push_frame(ctx, in, proxy)) < 0)
+        return ret;
+
+    av_frame_free(&fm->prev);
+    av_frame_free(&fm->cur);
+    av_frame_free(&fm->next);
+    av_frame_free(&fm->main_next);
+
+    link->w = frame->width;
+    link->h = frame->height;
+    return config_input(link);
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    FMDIFAnalyzeContext *fm = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    const int nb_inputs = fm->proxy ? 2 : 1;
+    int i, ret, status;
+    int64_t pts;
+
+    FF_FILTER_FORWARD_STATUS_BACK_ALL(outlink, ctx);
+
+    for (i = 0; i < nb_inputs; i++) {
+        if (fm->pending[i])
+            continue;
+        ret = ff_inlink_consume_frame(ctx->inputs[i], &fm->pending[i]);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (fm->pending[INPUT_MAIN] && (!fm->proxy || fm->pending[INPUT_PROXY])) {
+        AVFrame *in = fm->pending[INPUT_MAIN], *proxy = fm->pending[INPUT_PROXY];
+        const AVFrame *frame = proxy ? proxy : in;
+
+        fm->pending[INPUT_MAIN] = fm->pending[INPUT_PROXY] = NULL;
+        ff_filter_set_ready(ctx, 100);
+        if (fm->next && (frame->width  != fm->next->width || frame->height != fm->next->height ||
+                         frame->format != fm->next->format) &&
+            (ret = reconfigure(ctx, frame)) < 0) {
+            av_frame_free(&in);
+            av_frame_free(&proxy);
+            return ret;
+        }
+        return push_frame(ctx, in, proxy);
+    }
+
+    for (i = 0; i < nb_inputs; i++) {
+        if (!fm->eof && ff_inlink_acknowledge_status(ctx->inputs[i], &status, &pts)) {
+            fm->eof = 1;
+            /* analyze the last frame with itself as the lookahead */
+            if (fm->next) {
+                AVFrame *in = av_frame_clone(fm->main_next);
+                AVFrame *proxy = av_frame_clone(fm->next);
+
+                if (!in || !proxy) {
+                    av_frame_free(&in);
+                    av_frame_free(&proxy);
+                    return AVERROR(ENOMEM);
+                }
+                ret = push_frame(ctx, in, proxy);
+                if (ret < 0)
+                    return ret;
+            }
+            ff_outlink_set_status(outlink, status, pts);
+            return 0;
+        }
+    }
+
+    if (ff_outlink_frame_wanted(outlink)) {
+        for (i = 0; i < nb_inputs; i++)
+            if (!fm->pending[i])
+                ff_inlink_request_frame(ctx->inputs[i]);
+        return 0;
+    }
+
+    return FFERROR_NOT_READY;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    FMDIFAnalyzeContext *fm = ctx->priv;
+    AVFilterPad pad = {
+        .name         = "main",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = fm->proxy ? NULL : config_input,
+    };
+    int ret;
+
+    if ((ret = ff_append_inpad(ctx, &pad)) < 0)
+        return ret;
+
+    if (fm->proxy) {
+        pad.name         = "proxy";
+        pad.config_props = config_input;
+        if ((ret = ff_append_inpad(ctx, &pad)) < 0)
+            return ret;
+    }
+
+    /* the threshold is halved after an unmatched field, as fmdif2 does */
+    fm->match.halve = 1;
+    return ff_fmdif_match_reset_rhythm(&fm->match);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    FMDIFAnalyzeContext *fm = ctx->priv;
+
+    av_frame_free(&fm->prev);
+    av_frame_free(&fm->cur );
+    av_frame_free(&fm->next);
+    av_frame_free(&fm->main_next);
+    av_frame_free(&fm->pending[INPUT_MAIN]);
+    av_frame_free(&fm->pending[INPUT_PROXY]);
+
+    ff_fmdif_match_uninit(&fm->match);
+}
+
+static const enum AVPixelFormat pix_fmts[] = {
+    AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P, AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_YUVJ411P, AV_PIX_FMT_YUVJ420P,
+    AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_YUV420P9, AV_PIX_FMT_YUV422P9, AV_PIX_FMT_YUV444P9,
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUV420P12, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV444P12,
+    AV_PIX_FMT_YUV420P14, AV_PIX_FMT_YUV422P14, AV_PIX_FMT_YUV444P14,
+    AV_PIX_FMT_YUV420P16, AV_PIX_FMT_YUV422P16, AV_PIX_FMT_YUV444P16,
+    AV_PIX_FMT_YUVA420P, AV_PIX_FMT_YUVA422P, AV_PIX_FMT_YUVA444P,
+    AV_PIX_FMT_YUVA420P9, AV_PIX_FMT_YUVA422P9, AV_PIX_FMT_YUVA444P9,
+    AV_PIX_FMT_YUVA420P10, AV_PIX_FMT_YUVA422P10, AV_PIX_FMT_YUVA444P10,
+    AV_PIX_FMT_YUVA420P16, AV_PIX_FMT_YUVA422P16, AV_PIX_FMT_YUVA444P16,
+    AV_PIX_FMT_GBRP, AV_PIX_FMT_GBRP9, AV_PIX_FMT_GBRP10,
+    AV_PIX_FMT_GBRP12, AV_PIX_FMT_GBRP14, AV_PIX_FMT_GBRP16,
+    AV_PIX_FMT_GBRAP, AV_PIX_FMT_GBRAP16,
+    AV_PIX_FMT_GRAY8, AV_PIX_FMT_GRAY16,
+    AV_PIX_FMT_NV12, AV_PIX_FMT_NV21, AV_PIX_FMT_NV16,
+    AV_PIX_FMT_P010, AV_PIX_FMT_P016,
+    AV_PIX_FMT_NONE
+};
+
+static int process_command(AVFilterContext *ctx, const char *cmd, const char *args,
+                           char *res, int res_len, int flags)
+{
+    FMDIFAnalyzeContext *fm = ctx->priv;
+    FMDIFMatchContext *m = &fm->match;
+    const AVFilterLink *inlink = ctx->inputs[fm->proxy ? INPUT_PROXY : INPUT_MAIN];
+    const int blockx = m->comb.blockx, blocky = m->comb.blocky, cycle = m->cycle;
+    int ret;
+
+    ret = ff_filter_process_command(ctx, cmd, args, res, res_len, flags);
+    if (ret < 0)
+        return ret;
+
+    return ff_fmdif_match_update(m, inlink->w, inlink->h, blockx, blocky, cycle);
+}
+
+#define OFFSET(x) offsetof(FMDIFAnalyzeContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+#define RFLAGS FLAGS|AV_OPT_FLAG_RUNTIME_PARAM
+
+#define CONST(name, help, val, u) { name, help, 0, AV_OPT_TYPE_CONST, {.i64=val}, INT_MIN, INT_MAX, FLAGS, .unit = u }
+
+static const AVOption fmdifanalyze_options[] = {
+    { "parity", "specify the assumed picture field parity", OFFSET(parity), AV_OPT_TYPE_INT, {.i64=YADIF_PARITY_AUTO}, -1, 1, FLAGS, .unit = "parity" },
+    CONST("tff",  "assume top field first",    YADIF_PARITY_TFF,  "parity"),
+    CONST("bff",  "assume bottom field first", YADIF_PARITY_BFF,  "parity"),
+    CONST("auto", "auto detect parity",        YADIF_PARITY_AUTO, "parity"),
+
+    { "deint", "specify which frames to analyze", OFFSET(deint), AV_OPT_TYPE_INT, {.i64=YADIF_DEINT_INTERLACED}, 0, 1, FLAGS, .unit = "deint" },
+    CONST("all",        "analyze all frames",                       YADIF_DEINT_ALL,        "deint"),
+    CONST("interlaced", "only analyze frames marked as interlaced", YADIF_DEINT_INTERLACED, "deint"),
+
+    { "proxy",    "analyze the second input instead of the main one",                   OFFSET(proxy),   AV_OPT_TYPE_BOOL,{.i64= 0},  0,    1, FLAGS },
+    { "cthresh",  "set the area combing threshold used for combed frame detection",       OFFSET(match.comb.cthresh), AV_OPT_TYPE_INT, {.i64= 9}, -1, 0xff, RFLAGS },
+    { "chroma",   "set whether or not chroma is considered in the combed frame decision", OFFSET(match.comb.chroma),  AV_OPT_TYPE_BOOL,{.i64= 0},  0,    1, RFLAGS },
+    { "blockx",   "set the x-axis size of the window used during combed frame detection", OFFSET(match.comb.blockx),  AV_OPT_TYPE_INT, {.i64=16},  4, 1<<9, RFLAGS },
+    { "blocky",   "set the y-axis size of the window used during combed frame detection", OFFSET(match.comb.blocky),  AV_OPT_TYPE_INT, {.i64=16},  4, 1<<9, RFLAGS },
+    { "combpel",  "set the number of combed pixels inside any of the blocky by blockx size blocks on the frame for the frame to be detected as combed", OFFSET(match.comb.combpel), AV_OPT_TYPE_INT, {.i64=100}, 0, INT_MAX, RFLAGS },
+    { "combtol",  "refine at full resolution only the comb scores estimated this close to combpel, 0 to disable", OFFSET(match.comb.combtol), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FLAGS },
+    { "chromatol", "only add the chroma to the luma comb scores this close to combpel, 0 to always add it", OFFSET(match.comb.chromatol), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FLAGS },
+    { "metric",   "set the metric scoring the candidate matches", OFFSET(match.comb.metric), AV_OPT_TYPE_INT, {.i64=FMDIF_METRIC_COMB}, 0, 1, FLAGS, .unit = "metric" },
+    { "comb",      "fieldmatch comb score",             0, AV_OPT_TYPE_CONST, {.i64=FMDIF_METRIC_COMB},      INT_MIN, INT_MAX, FLAGS, .unit = "metric" },
+    { "fielddiff", "mean difference of adjacent lines", 0, AV_OPT_TYPE_CONST, {.i64=FMDIF_METRIC_FIELDDIFF}, INT_MIN, INT_MAX, FLAGS, .unit = "metric" },
+    { "fdthresh", "set the mean line difference from which a candidate is combed with the fielddiff metric", OFFSET(match.comb.fdthresh), AV_OPT_TYPE_DOUBLE, {.dbl=4}, 0, 255, FLAGS },
+    { "roi_x", "set the left edge of the analysis rectangle", OFFSET(match.comb.roi_x), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FLAGS },
+    { "roi_y", "set the top edge of the analysis rectangle", OFFSET(match.comb.roi_y), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FLAGS },
+    { "roi_w", "set the width of the analysis rectangle, 0 to reach the right edge", OFFSET(match.comb.roi_w), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FLAGS },
+    { "roi_h", "set the height of the analysis rectangle, 0 to reach the bottom edge", OFFSET(match.comb.roi_h), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FLAGS },
+    { "borders", "set the number of frames between black border detections, 0 to disable", OFFSET(match.comb.borders), AV_OPT_TYPE_INT, {.i64=0}, 0, INT_MAX, FLAGS },
+    { "borderthresh", "set the mean luma of a black border line", OFFSET(match.comb.borderthresh), AV_OPT_TYPE_INT, {.i64=32}, 0, 255, FLAGS },
+    { "cycle",    "set the number of frames you want to keep the rhythm", OFFSET(match.cycle), AV_OPT_TYPE_INT, {.i64 = 5}, 2, 25, RFLAGS },
+
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(fmdifanalyze);
+
+static const AVFilterPad avfilter_vf_fmdifanalyze_outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+    },
+};
+
+const AVFilter ff_vf_fmdifanalyze = {
+    .name          = "fmdifanalyze",
+    .description   = NULL_IF_CONFIG_SMALL("Analyze field matching for fmdif/fmdif2 and export it as metadata."),
+    .priv_size     = sizeof(FMDIFAnalyzeContext),
+    .priv_class    = &fmdifanalyze_class,
+    .init          = init,
+    .uninit        = uninit,
+    .process_command = process_command,
+    .activate      = activate,
+    .inputs        = NULL,
+    FILTER_OUTPUTS(avfilter_vf_fmdifanalyze_outputs),
+    FILTER_PIXFMTS_ARRAY(pix_fmts),
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_METADATA_ONLY,
+};
@@ -0,0 +1,428 @@
+/*
+ * libfmdif: field matching deinterlacer core, outside of libavfilter
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * The comb detection is that of the fmdif filters, based on vf_fieldmatch:
+ * Copyright (c) 2012 Fredrik Mellbin
+ * Copyright (c) 2013 Clément Bœsch
+ *
+ * The interpolation is that of vf_yadif:
+ * Copyright (C) 2006-2011 Michael Niedermayer <michaelni@gmx.at>
+ *               2010      James Darnley <james.darnley@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This is the decision of fmdif2 with the yadif interpolator, for 8-bit
+ * planar input, without the libavfilter framework: the pictures are copied
+ * into a window of three frames, and each output field is either the best
+ * weave of the current frame with a neighbour or interpolated. The comb
+ * kernels, the decision and the yadif line kernels are those of the
+ * filters, built from 7.0/fmdif_core.c which only depends on the C library;
+ * only the frame window and the scoring order are kept here. The options
+ * the filters add on top of them (the other interpolators, the pre-screen,
+ * the pulldown flags, the state, send_film, ...) are left out on purpose.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmdif.h"
+#include "fmdif_core.h"
+
+#define FFALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+/* frames of the window, plus the one being pushed */
+#define NB_FRAMES 4
+
+typedef struct Frame {
+    uint8_t *data[3];
+    ptrdiff_t linesize[3];
+    int64_t pts;
+} Frame;
+
+struct FMDIFContext {
+    FMDIFParams p;
+    int w[3], h[3];                 ///< size of each plane
+    int use_chroma;                 ///< chroma is scored
+
+    Frame frames[NB_FRAMES];
+    Frame *free_frames[NB_FRAMES];
+    int nb_free;
+    Frame *prev, *cur, *next;
+    int64_t duration;               ///< pts difference of the last two frames
+
+    Frame weave[2];                 ///< mP and mN weaves of the current frame
+    int weave_p;                    ///< index of the mP weave
+    int score_p, score_n;           ///< scores of the weaves, -1 if unknown
+    int score_c;                    ///< score of the current frame, -1 if unknown
+
+    Frame out[2];
+    int out_match[2];
+    int64_t out_pts[2];
+    int nb_out, out_pos;
+
+    uint8_t *cmask[3];
+    ptrdiff_t cmask_linesize[3];
+    int *c_array;
+    FMDIFCountBlocksFn count_blocks;
+    FMDIFScoreLumaFn score_luma;
+    int *last_match;                ///< last matches in cycle, of the first then second fields
+    int fid;                        ///< position of the current frame in cycle
+    int eof;
+};
+
+static int alloc_frame(const FMDIFContext *ctx, Frame *f)
+{
+    int i;
+
+    for (i = 0; i < ctx->p.nb_planes; i++) {
+        f->linesize[i] = FFALIGN(ctx->w[i], 32);
+        f->data[i] = malloc(f->linesize[i] * ctx->h[i]);
+        if (!f->data[i])
+            return FMDIF_ERROR_NOMEM;
+    }
+    return FMDIF_OK;
+}
+
+static void free_frame(Frame *f)
+{
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        free(f->data[i]);
+        f->data[i] = NULL;
+    }
+}
+
+static void copy_plane(uint8_t *dst, ptrdiff_t dst_linesize,
+                       const uint8_t *src, ptrdiff_t src_linesize, int w, int h)
+{
+    for (; h > 0; h--) {
+        memcpy(dst, src, w);
+        dst += dst_linesize;
+        src += src_linesize;
+    }
+}
+
+static void copy_frame(const FMDIFContext *ctx, Frame *dst, const uint8_t *const data[3],
+                       const ptrdiff_t linesize[3])
+{
+    int i;
+
+    for (i = 0; i < ctx->p.nb_planes; i++)
+        copy_plane(dst->data[i], dst->linesize[i], data[i], linesize[i], ctx->w[i], ctx->h[i]);
+}
+
+/* copy the lines of parity field */
+static void copy_fields(const FMDIFContext *ctx, Frame *dst, const Frame *src, int field)
+{
+    int i;
+
+    for (i = 0; i < ctx->p.nb_planes; i++)
+        copy_plane(dst->data[i] + field * dst->linesize[i], dst->linesize[i] << 1,
+                   src->data[i] + field * src->linesize[i], src->linesize[i] << 1,
+                   ctx->w[i], (ctx->h[i] >> 1) + (field ? 0 : ctx->h[i] & 1));
+}
+
+static void weave(const FMDIFContext *ctx, Frame *dst, int match)
+{
+    const int field = ctx->p.tff;
+
+    if (match == mP) {
+        copy_fields(ctx, dst, ctx->cur, 1 - field);
+        copy_fields(ctx, dst, ctx->prev, field);
+    } else {
+        copy_fields(ctx, dst, ctx->cur, field);
+        copy_fields(ctx, dst, ctx->next, 1 - field);
+    }
+}
+
+/* comb detection, with the kernels of the filters */
+
+static int comb_score(const FMDIFContext *ctx, const Frame *src)
+{
+    int i;
+
+    if (!ctx->use_chroma || ctx->p.cthresh < 0)
+        return ctx->score_luma(ctx->cmask[0], ctx->cmask_linesize[0], src->data[0], src->linesize[0],
+                               ctx->w[0], ctx->h[0], ctx->p.blockx, ctx->p.blocky,
+                               ctx->p.cthresh, ctx->c_array);
+    for (i = 0; i < 3; i++)
+        ff_fmdif_comb_mask_plane(ctx->cmask[i], ctx->cmask_linesize[i], src->data[i], src->linesize[i],
+                                 ctx->w[i], ctx->h[i], 1, ctx->p.cthresh);
+    ff_fmdif_comb_dilate_chroma(ctx->cmask[0], ctx->cmask_linesize[0], ctx->cmask[1], ctx->cmask[2],
+                                ctx->cmask_linesize[1], ctx->w[1], ctx->h[1]);
+    return ctx->count_blocks(ctx->cmask[0], ctx->cmask_linesize[0], ctx->w[0], ctx->h[0],
+                             ctx->p.blockx, ctx->p.blocky, ctx->c_array);
+}
+
+static void deinterlace(const FMDIFContext *ctx, Frame *dst, int is_second)
+{
+    const Frame *prev = ctx->prev ? ctx->prev : ctx->cur;
+    const Frame *cur  = ctx->cur;
+    const Frame *next = ctx->next ? ctx->next : ctx->cur;
+    /* lines of the field being output, kept from cur */
+    const int keep = is_second ^ !ctx->p.tff;
+    const int edge = 3 + FMDIF_YADIF_MAX_ALIGN - 1;
+    int i, y;
+
+    for (i = 0; i < ctx->p.nb_planes; i++) {
+        const ptrdiff_t refs = cur->linesize[i];
+        const int w = ctx->w[i];
+        const int h = ctx->h[i];
+
+        for (y = 0; y < h; y++) {
+            uint8_t *d = dst->data[i] + y * dst->linesize[i];
+
+            if ((y ^ keep) & 1) {
+                const int mode = y == 1 || y + 2 == h ? 2 : 0;
+
+                uint8_t *p = prev->data[i] + y * refs;
+                uint8_t *c = cur ->data[i] + y * refs;
+                uint8_t *n = next->data[i] + y * refs;
+                const int prefs = y + 1 < h ? refs : -refs;
+                const int mrefs = y ? -refs : refs;
+
+                /* split as ff_fmdif_yadif_slice() does without SIMD */
+                ff_fmdif_yadif_line(d + 3, p + 3, c + 3, n + 3, w - edge,
+                                    prefs, mrefs, !is_second, mode);
+                ff_fmdif_yadif_edges(d, p, c, n, w, prefs, mrefs, !is_second, mode);
+            } else {
+                memcpy(d, cur->data[i] + y * refs, w);
+            }
+        }
+    }
+}
+
+/* field matching, the decision being ff_fmdif_match_field() of the filters */
+
+static int get_score(void *opaque, int match, int *full)
+{
+    FMDIFContext *ctx = opaque;
+
+    /* the chroma is never scored apart */
+    *full = 1;
+    switch (match) {
+    case mC:
+        if (ctx->score_c < 0)
+            ctx->score_c = comb_score(ctx, ctx->cur);
+        return ctx->score_c;
+    case mP:
+        if (ctx->score_p < 0 && ctx->prev) {
+            weave(ctx, &ctx->weave[ctx->weave_p], mP);
+            ctx->score_p = comb_score(ctx, &ctx->weave[ctx->weave_p]);
+        }
+        return ctx->score_p;
+    default:
+        if (ctx->score_n < 0 && ctx->next) {
+            weave(ctx, &ctx->weave[!ctx->weave_p], mN);
+            ctx->score_n = comb_score(ctx, &ctx->weave[!ctx->weave_p]);
+        }
+        return ctx->score_n;
+    }
+}
+
+static int match_field(FMDIFContext *ctx, int is_second)
+{
+    int *last_match = &ctx->last_match[ctx->fid + ctx->p.cycle * is_second];
+
+    *last_match = ff_fmdif_match_field(*last_match, is_second, ctx->p.combpel, 1, 0, get_score, ctx);
+    return *last_match;
+}
+
+static void output_field(FMDIFContext *ctx, int is_second)
+{
+    const int idx = ctx->nb_out++;
+    Frame *dst = &ctx->out[idx];
+    const int match = match_field(ctx, is_second);
+    int i;
+
+    if (match == FMDIF_MATCH_DEINT) {
+        deinterlace(ctx, dst, is_second);
+    } else {
+        const Frame *src = match == mC ? ctx->cur :
+                           match == mP ? &ctx->weave[ctx->weave_p] : &ctx->weave[!ctx->weave_p];
+        for (i = 0; i < ctx->p.nb_planes; i++)
+            copy_plane(dst->data[i], dst->linesize[i], src->data[i], src->linesize[i],
+                       ctx->w[i], ctx->h[i]);
+    }
+    ctx->out_match[idx] = match;
+    ctx->out_pts[idx] = ctx->p.field_rate ? ctx->cur->pts * 2 + is_second * ctx->duration
+                                          : ctx->cur->pts;
+}
+
+static void process_frame(FMDIFContext *ctx)
+{
+    if (ctx->next)
+        ctx->duration = ctx->next->pts - ctx->cur->pts;
+
+    /* the mN weave of the previous frame is the mP weave of this one */
+    if (ctx->score_n >= 0 && ctx->prev) {
+        ctx->weave_p = !ctx->weave_p;
+        ctx->score_p = ctx->score_n;
+    } else {
+        ctx->score_p = -1;
+    }
+    ctx->score_n = -1;
+    ctx->score_c = -1;
+
+    ctx->nb_out = ctx->out_pos = 0;
+    output_field(ctx, 0);
+    if (ctx->p.field_rate)
+        output_field(ctx, 1);
+    if (++ctx->fid >= ctx->p.cycle)
+        ctx->fid = 0;
+}
+
+void fmdif_params_default(FMDIFParams *p, int width, int height)
+{
+    memset(p, 0, sizeof(*p));
+    p->width         = width;
+    p->height        = height;
+    p->nb_planes     = 3;
+    p->log2_chroma_w = 1;
+    p->log2_chroma_h = 1;
+    p->tff           = 1;
+    p->cthresh       = 9;
+    p->chroma        = 0;
+    p->blockx        = 16;
+    p->blocky        = 16;
+    p->combpel       = 100;
+    p->cycle         = 5;
+}
+
+FMDIFContext *fmdif_alloc(const FMDIFParams *p)
+{
+    FMDIFContext *ctx;
+    int i, ret = FMDIF_OK;
+
+    if (p->width < 3 || p->height < 4 || (p->nb_planes != 1 && p->nb_planes != 3) ||
+        p->log2_chroma_w < 0 || p->log2_chroma_w > 2 || p->log2_chroma_h < 0 || p->log2_chroma_h > 1 ||
+        p->blockx < 4 || p->blockx > 512 || p->blockx & (p->blockx - 1) ||
+        p->blocky < 4 || p->blocky > 512 || p->blocky & (p->blocky - 1) ||
+        p->cthresh < -1 || p->cthresh > 255 || p->combpel < 0 || p->cycle < 2 || p->cycle > 25)
+        return NULL;
+    ctx = calloc(1, sizeof(*ctx));
+    if (!ctx)
+        return NULL;
+
+    ctx->p = *p;
+    for (i = 0; i < 3; i++) {
+        ctx->w[i] = i ? -((-p->width)  >> p->log2_chroma_w) : p->width;
+        ctx->h[i] = i ? -((-p->height) >> p->log2_chroma_h) : p->height;
+    }
+    /* the chroma dilation of fieldmatch expects 4:2:0 */
+    ctx->use_chroma = p->chroma && p->nb_planes == 3 &&
+                      p->log2_chroma_w == 1 && p->log2_chroma_h == 1 && ctx->h[1] >= 4;
+
+    for (i = 0; i < NB_FRAMES && ret == FMDIF_OK; i++) {
+        ret = alloc_frame(ctx, &ctx->frames[i]);
+        ctx->free_frames[ctx->nb_free++] = &ctx->frames[i];
+    }
+    for (i = 0; i < 2 && ret == FMDIF_OK; i++)
+        if ((ret = alloc_frame(ctx, &ctx->weave[i])) == FMDIF_OK)
+            ret = alloc_frame(ctx, &ctx->out[i]);
+    for (i = 0; i < p->nb_planes && ret == FMDIF_OK; i++) {
+        ctx->cmask_linesize[i] = FFALIGN(ctx->w[i], 32);
+        ctx->cmask[i] = calloc(ctx->h[i], ctx->cmask_linesize[i]);
+        if (!ctx->cmask[i])
+            ret = FMDIF_ERROR_NOMEM;
+    }
+    ctx->c_array = malloc(ff_fmdif_comb_blocks_size(p->width, p->height, p->blockx, p->blocky) *
+                          sizeof(*ctx->c_array));
+    ctx->count_blocks = ff_fmdif_comb_count_blocks_fn(p->blockx, p->blocky);
+    ctx->score_luma   = ff_fmdif_comb_score_luma_fn(p->blockx, p->blocky, 1, p->cthresh);
+    ctx->last_match = malloc(2 * p->cycle * sizeof(*ctx->last_match));
+    if (ret != FMDIF_OK || !ctx->c_array || !ctx->last_match) {
+        fmdif_free(&ctx);
+        return NULL;
+    }
+    for (i = 0; i < 2 * p->cycle; i++)
+        ctx->last_match[i] = FMDIF_MATCH_DEINT;
+    ctx->score_p = ctx->score_n = ctx->score_c = -1;
+    ctx->duration = 1;
+    return ctx;
+}
+
+void fmdif_free(FMDIFContext **pctx)
+{
+    FMDIFContext *ctx = *pctx;
+    int i;
+
+    if (!ctx)
+        return;
+    for (i = 0; i < NB_FRAMES; i++)
+        free_frame(&ctx->frames[i]);
+    for (i = 0; i < 2; i++) {
+        free_frame(&ctx->weave[i]);
+        free_frame(&ctx->out[i]);
+    }
+    for (i = 0; i < 3; i++)
+        free(ctx->cmask[i]);
+    free(ctx->c_array);
+    free(ctx->last_match);
+    free(ctx);
+    *pctx = NULL;
+}
+
+int fmdif_push_frame(FMDIFContext *ctx, const FMDIFPicture *in)
+{
+    Frame *frame = NULL;
+
+    if (ctx->out_pos < ctx->nb_out)
+        return FMDIF_ERROR_AGAIN;
+    if (ctx->eof)
+        return FMDIF_ERROR_EOF;
+
+    if (in) {
+        frame = ctx->free_frames[--ctx->nb_free];
+        copy_frame(ctx, frame, (const uint8_t *const *)in->data, in->linesize);
+        frame->pts = in->pts;
+    } else {
+        ctx->eof = 1;
+    }
+
+    if (ctx->prev)
+        ctx->free_frames[ctx->nb_free++] = ctx->prev;
+    ctx->prev = ctx->cur;
+    ctx->cur  = ctx->next;
+    ctx->next = frame;
+
+    /* wait for the lookahead frame */
+    if (ctx->cur)
+        process_frame(ctx);
+    return FMDIF_OK;
+}
+
+int fmdif_pull_frame(FMDIFContext *ctx, FMDIFPicture *out)
+{
+    const Frame *f;
+    int i;
+
+    if (ctx->out_pos >= ctx->nb_out)
+        return ctx->eof ? FMDIF_ERROR_EOF : FMDIF_ERROR_AGAIN;
+
+    f = &ctx->out[ctx->out_pos];
+    for (i = 0; i < 3; i++) {
+        out->data[i]     = f->data[i];
+        out->linesize[i] = f->linesize[i];
+    }
+    out->pts   = ctx->out_pts[ctx->out_pos];
+    out->match = ctx->out_match[ctx->out_pos];
+    ctx->out_pos++;
+    return FMDIF_OK;
+}
@@ -0,0 +1,104 @@
+/*
+ * libfmdif: field matching deinterlacer core, outside of libavfilter
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FMDIF_H
+#define FMDIF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* return codes */
+#define FMDIF_OK             0
+#define FMDIF_ERROR_AGAIN  (-1)     ///< push more input, or pull the pending output first
+#define FMDIF_ERROR_EOF    (-2)     ///< all frames were output after the end of the stream
+#define FMDIF_ERROR_NOMEM  (-3)
+#define FMDIF_ERROR_INVAL  (-4)
+
+/* values of FMDIFPicture.match */
+#define FMDIF_MATCH_DEINT  (-1)     ///< no match, the field was interpolated
+#define FMDIF_MATCH_P        0      ///< woven with the previous frame
+#define FMDIF_MATCH_C        1      ///< the current frame as is
+#define FMDIF_MATCH_N        2      ///< woven with the next frame
+
+/* 8-bit planar picture: luma, then the two chroma planes if any */
+typedef struct FMDIFPicture {
+    uint8_t *data[3];
+    ptrdiff_t linesize[3];
+    int64_t pts;
+    int match;                      ///< output only, FMDIF_MATCH_*
+} FMDIFPicture;
+
+typedef struct FMDIFParams {
+    /* format of the pictures */
+    int width, height;
+    int nb_planes;                  ///< 1 for gray, 3 for YUV
+    int log2_chroma_w, log2_chroma_h;
+
+    int tff;                        ///< 1 if the top field is first
+    int field_rate;                 ///< output one frame per field instead of per frame
+
+    /* comb detection, as the options of the fmdif filters */
+    int cthresh;
+    int chroma;                     ///< only used with 4:2:0 chroma
+    int blockx, blocky;
+    int combpel;
+    int cycle;
+} FMDIFParams;
+
+typedef struct FMDIFContext FMDIFContext;
+
+/**
+ * Set the defaults of fmdif2 for a width x height 4:2:0 top field first
+ * input, output at the frame rate.
+ */
+void fmdif_params_default(FMDIFParams *p, int width, int height);
+
+/**
+ * Return a context for the pictures described by p, or NULL if p is invalid
+ * or on allocation failure.
+ */
+FMDIFContext *fmdif_alloc(const FMDIFParams *p);
+
+void fmdif_free(FMDIFContext **ctx);
+
+/**
+ * Push a picture, which is copied, or NULL at the end of the stream.
+ * Return FMDIF_ERROR_AGAIN if an output is pending, in which case the
+ * picture was not taken.
+ */
+int fmdif_push_frame(FMDIFContext *ctx, const FMDIFPicture *in);
+
+/**
+ * Pull an output picture. Its planes belong to the context and stay valid
+ * until the next push or pull. Return FMDIF_ERROR_AGAIN if more input is
+ * needed, or FMDIF_ERROR_EOF after the last picture.
+ *
+ * With field_rate, the pts are in units of half those of the input.
+ */
+int fmdif_pull_frame(FMDIFContext *ctx, FMDIFPicture *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FMDIF_H */
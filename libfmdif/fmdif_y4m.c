@@ -0,0 +1,275 @@
+/*
+ * fmdif_y4m: run libfmdif on a y4m stream or a raw yuv file
+ * Copyright (C) 2024 Tsunehisa Kazawa <digitune+ffmpeg@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Usage: fmdif_y4m [options] < in.y4m > out.y4m
+ *        fmdif_y4m [options] -i in.yuv -s WxH [-f 420|422|444|mono] [-r num:den] > out.y4m
+ *
+ * The output is a progressive y4m stream, at twice the frame rate with
+ * -m field.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fmdif.h"
+
+typedef struct Format {
+    const char *name;               ///< y4m colorspace, also the -f value
+    int nb_planes;
+    int log2_chroma_w, log2_chroma_h;
+} Format;
+
+static const Format formats[] = {
+    { "420jpeg",  3, 1, 1 },
+    { "420paldv", 3, 1, 1 },
+    { "420mpeg2", 3, 1, 1 },
+    { "420",      3, 1, 1 },
+    { "422",      3, 1, 0 },
+    { "444",      3, 0, 0 },
+    { "mono",     1, 0, 0 },
+};
+
+static const Format *find_format(const char *name, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+        if (strlen(formats[i].name) == len && !strncmp(formats[i].name, name, len))
+            return &formats[i];
+    return NULL;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: fmdif_y4m [options] < in.y4m > out.y4m\n"
+            "       fmdif_y4m [options] -i in.yuv -s WxH [-f 420|422|444|mono] [-r num:den] > out.y4m\n"
+            "options:\n"
+            "  -m frame|field   output one frame per frame or per field (frame)\n"
+            "  -p tff|bff       field order, overriding the y4m header (tff)\n"
+            "  -cthresh N       comb threshold (9)\n"
+            "  -chroma 0|1      score chroma, 4:2:0 only (0)\n"
+            "  -blockx N        comb block width (16)\n"
+            "  -blocky N        comb block height (16)\n"
+            "  -combpel N       combed pixels threshold (100)\n"
+            "  -cycle N         cycle of the last matches (5)\n"
+            "  -v               print the match statistics to stderr\n");
+    exit(1);
+}
+
+/* parse the y4m stream header, leaving the unset values as they are */
+static int read_y4m_header(FILE *f, FMDIFParams *p, const Format **fmt,
+                           int *rate_num, int *rate_den, int *tff)
+{
+    char line[1024], *tok;
+
+    if (!fgets(line, sizeof(line), f) || strncmp(line, "YUV4MPEG2 ", 10))
+        return -1;
+    line[strcspn(line, "\n")] = 0;
+    for (tok = strtok(line + 10, " "); tok; tok = strtok(NULL, " ")) {
+        switch (tok[0]) {
+        case 'W': p->width  = atoi(tok + 1); break;
+        case 'H': p->height = atoi(tok + 1); break;
+        case 'F': sscanf(tok + 1, "%d:%d", rate_num, rate_den); break;
+        case 'I':
+            if (tok[1] == 't' || tok[1] == 'b')
+                *tff = tok[1] == 't';
+            break;
+        case 'C':
+            if (!(*fmt = find_format(tok + 1, strcspn(tok + 1, " ")))) {
+                fprintf(stderr, "unsupported colorspace %s\n", tok + 1);
+                return -1;
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+static size_t plane_size(const FMDIFParams *p, int plane, int *w, int *h)
+{
+    *w = plane ? -((-p->width)  >> p->log2_chroma_w) : p->width;
+    *h = plane ? -((-p->height) >> p->log2_chroma_h) : p->height;
+    return (size_t)*w * *h;
+}
+
+static int write_frame(FILE *f, const FMDIFParams *p, const FMDIFPicture *pic)
+{
+    int i, w, h, y;
+
+    fputs("FRAME\n", f);
+    for (i = 0; i < p->nb_planes; i++) {
+        plane_size(p, i, &w, &h);
+        for (y = 0; y < h; y++)
+            if (fwrite(pic->data[i] + y * pic->linesize[i], 1, w, f) != (size_t)w)
+                return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    FMDIFParams p;
+    const Format *fmt = &formats[0];
+    FMDIFContext *ctx;
+    FMDIFPicture in, out;
+    const char *input = NULL;
+    const uint8_t *map = NULL;
+    size_t map_size = 0, frame_size = 0, pos = 0;
+    int rate_num = 30000, rate_den = 1001, tff = -1, field_rate = 0, verbose = 0;
+    int width = 0, height = 0, header_tff = 1;
+    long nb_matches[4] = { 0 };
+    uint8_t *buf = NULL;
+    int64_t pts = 0;
+    int i, ret;
+
+    fmdif_params_default(&p, 0, 0);
+    for (i = 1; i < argc; i++) {
+        const char *opt = argv[i], *arg = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(opt, "-v")) {
+            verbose = 1;
+            continue;
+        }
+        if (!arg)
+            usage();
+        i++;
+        if      (!strcmp(opt, "-m"))       field_rate = !strcmp(arg, "field");
+        else if (!strcmp(opt, "-p"))       tff = strcmp(arg, "bff") != 0;
+        else if (!strcmp(opt, "-cthresh")) p.cthresh = atoi(arg);
+        else if (!strcmp(opt, "-chroma"))  p.chroma = atoi(arg);
+        else if (!strcmp(opt, "-blockx"))  p.blockx = atoi(arg);
+        else if (!strcmp(opt, "-blocky"))  p.blocky = atoi(arg);
+        else if (!strcmp(opt, "-combpel")) p.combpel = atoi(arg);
+        else if (!strcmp(opt, "-cycle"))   p.cycle = atoi(arg);
+        else if (!strcmp(opt, "-i"))       input = arg;
+        else if (!strcmp(opt, "-s"))       sscanf(arg, "%dx%d", &width, &height);
+        else if (!strcmp(opt, "-r"))       sscanf(arg, "%d:%d", &rate_num, &rate_den);
+        else if (!strcmp(opt, "-f") && !(fmt = find_format(arg, strlen(arg)))) usage();
+        else if (strcmp(opt, "-f"))        usage();
+    }
+
+    if (input) {
+        struct stat st;
+        int fd = open(input, O_RDONLY);
+
+        p.width  = width;
+        p.height = height;
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            perror(input);
+            return 1;
+        }
+        map_size = st.st_size;
+        if (map_size) {
+            map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                perror(input);
+                return 1;
+            }
+        }
+        close(fd);
+    } else if (read_y4m_header(stdin, &p, &fmt, &rate_num, &rate_den, &header_tff) < 0) {
+        fprintf(stderr, "invalid y4m header\n");
+        return 1;
+    }
+    p.nb_planes     = fmt->nb_planes;
+    p.log2_chroma_w = fmt->log2_chroma_w;
+    p.log2_chroma_h = fmt->log2_chroma_h;
+    p.tff           = tff >= 0 ? tff : header_tff;
+    p.field_rate    = field_rate;
+
+    ctx = fmdif_alloc(&p);
+    if (!ctx) {
+        fprintf(stderr, "invalid parameters\n");
+        return 1;
+    }
+
+    memset(&in, 0, sizeof(in));
+    for (i = 0; i < p.nb_planes; i++) {
+        int w, h;
+        frame_size += plane_size(&p, i, &w, &h);
+        in.linesize[i] = w;
+    }
+    if (!map && !(buf = malloc(frame_size))) {
+        fmdif_free(&ctx);
+        return 1;
+    }
+
+    printf("YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C%s\n", p.width, p.height,
+           field_rate ? rate_num * 2 : rate_num, rate_den,
+           fmt->nb_planes == 1 ? "mono" : fmt->name);
+
+    for (;;) {
+        const uint8_t *src = NULL;
+
+        if (map) {
+            if (pos + frame_size <= map_size) {
+                src = map + pos;
+                pos += frame_size;
+            }
+        } else {
+            char line[256];
+
+            /* frame parameters are ignored */
+            if (fgets(line, sizeof(line), stdin) && !strncmp(line, "FRAME", 5) &&
+                fread(buf, 1, frame_size, stdin) == frame_size)
+                src = buf;
+        }
+        if (src) {
+            size_t offset = 0;
+            int w, h;
+
+            for (i = 0; i < p.nb_planes; i++) {
+                in.data[i] = (uint8_t *)src + offset;
+                offset += plane_size(&p, i, &w, &h);
+            }
+            in.pts = pts++;
+        }
+        ret = fmdif_push_frame(ctx, src ? &in : NULL);
+        if (ret < 0)
+            break;
+
+        while ((ret = fmdif_pull_frame(ctx, &out)) == FMDIF_OK) {
+            nb_matches[out.match + 1]++;
+            if (write_frame(stdout, &p, &out) < 0) {
+                ret = FMDIF_ERROR_INVAL;
+                break;
+            }
+        }
+        if (ret != FMDIF_ERROR_AGAIN)
+            break;
+    }
+
+    if (verbose)
+        fprintf(stderr, "p: %ld c: %ld n: %ld deinterlaced: %ld\n",
+                nb_matches[FMDIF_MATCH_P + 1], nb_matches[FMDIF_MATCH_C + 1],
+                nb_matches[FMDIF_MATCH_N + 1], nb_matches[FMDIF_MATCH_DEINT + 1]);
+
+    fmdif_free(&ctx);
+    free(buf);
+    if (map)
+        munmap((void *)map, map_size);
+    return ret == FMDIF_ERROR_EOF ? 0 : 1;
+}